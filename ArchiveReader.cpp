@@ -0,0 +1,765 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#include "ArchiveReader.hpp"
+
+#include <boost/algorithm/string.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ios>
+
+static bool seekFile(FILE *file, boost::uint64_t offset)
+{
+#ifdef _WIN32
+  return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+  return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static boost::uint64_t fileSize(FILE *file)
+{
+#ifdef _WIN32
+  _fseeki64(file, 0, SEEK_END);
+  return (boost::uint64_t)_ftelli64(file);
+#else
+  fseeko(file, 0, SEEK_END);
+  return (boost::uint64_t)ftello(file);
+#endif
+}
+
+static boost::uint64_t little(const unsigned char *data, int size)
+{
+  boost::uint64_t value = 0;
+  for(int i=size-1;i>=0;i--) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+/** ZipMemberBuffer reads a stored or deflated member of a zip archive, which
+ *  ends after its compressed size, and checks its size and CRC at the end. */
+class ZipMemberBuffer : public DecompressionBuffer
+{
+public:
+  ZipMemberBuffer(FILE *file, int method, boost::uint64_t compressedSize, boost::uint64_t size,
+    boost::uint32_t crc) : DecompressionBuffer(file, 1 << 18), m_method(method), m_size(size),
+    m_crc(crc), m_done(0), m_runningCrc(crc32(0, Z_NULL, 0)), m_ended(false)
+  {
+    m_inputLeft = compressedSize;
+    std::memset(&m_stream, 0, sizeof(z_stream));
+    // Zip members are raw deflate data without a zlib header
+    if(m_method == 8 && inflateInit2(&m_stream, -15) != Z_OK) {
+      m_error = "Failed to start deflate decompression";
+    }
+  }
+
+  virtual ~ZipMemberBuffer()
+  {
+    if(m_method == 8) {
+      inflateEnd(&m_stream);
+    }
+  }
+
+protected:
+  virtual bool decompress(char *output, std::size_t size, std::size_t &produced)
+  {
+    produced = 0;
+    if(!m_error.empty()) {
+      return false;
+    }
+    while(!produced) {
+      if(!m_available && !fillInput()) {
+        if(!m_error.empty()) {
+          return false;
+        }
+        if(m_done != m_size || (m_method == 8 && !m_ended)) {
+          m_error = "Archive member is truncated";
+          return false;
+        }
+        if(m_runningCrc != m_crc) {
+          m_error = "Archive member is corrupt (CRC mismatch)";
+          return false;
+        }
+        return true;
+      }
+      if(m_method == 0) {
+        produced = std::min(size, m_available);
+        std::memcpy(output, m_next, produced);
+        m_next += produced;
+        m_available -= produced;
+      } else if(m_ended) {
+        // Anything after the end of the deflate data is padding
+        m_available = 0;
+      } else {
+        m_stream.next_in = (Bytef*)m_next;
+        m_stream.avail_in = (uInt)m_available;
+        m_stream.next_out = (Bytef*)output;
+        m_stream.avail_out = (uInt)size;
+        int rc = inflate(&m_stream, Z_NO_FLUSH);
+        m_next += m_available - m_stream.avail_in;
+        m_available = m_stream.avail_in;
+        produced = size - m_stream.avail_out;
+        if(rc == Z_STREAM_END) {
+          m_ended = true;
+        } else if(rc != Z_OK && rc != Z_BUF_ERROR) {
+          m_error = "Archive member is corrupt";
+          if(m_stream.msg) {
+            m_error += std::string(" (") + m_stream.msg + ")";
+          }
+          return false;
+        }
+      }
+      m_runningCrc = crc32(m_runningCrc, (const Bytef*)output, (uInt)produced);
+      m_done += produced;
+      if(m_done > m_size) {
+        m_error = "Archive member is longer than its recorded size";
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  int m_method;
+  boost::uint64_t m_size;
+  boost::uint32_t m_crc;
+  boost::uint64_t m_done;
+  uLong m_runningCrc;
+  bool m_ended;
+  z_stream m_stream;
+};
+
+/** TarMemberBuffer reads the current member of a tar archive through the
+ *  reader, stopping at the end of the member. */
+class TarMemberBuffer : public std::streambuf
+{
+public:
+  explicit TarMemberBuffer(ArchiveReader &reader) : m_reader(reader), m_buffer(1 << 16), m_done(0)
+  {
+    setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+  }
+
+protected:
+  virtual int_type underflow()
+  {
+    if(gptr() < egptr()) {
+      return traits_type::to_int_type(*gptr());
+    }
+    std::size_t n = (std::size_t)std::min<boost::uint64_t>(m_buffer.size(), m_reader.m_memberLeft);
+    if(!n) {
+      return traits_type::eof();
+    }
+    if(!m_reader.readTar(&m_buffer[0], n)) {
+      // The istream catches this and sets badbit
+      throw std::ios_base::failure(m_reader.m_error);
+    }
+    m_reader.m_memberLeft -= n;
+    m_done += n;
+    setg(&m_buffer[0], &m_buffer[0], &m_buffer[0] + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+  {
+    if(off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::in)) {
+      return pos_type(off_type(-1));
+    }
+    return pos_type(off_type(m_done - (egptr() - gptr())));
+  }
+
+private:
+  ArchiveReader &m_reader;
+  std::vector<char> m_buffer;
+  boost::uint64_t m_done;
+};
+
+ArchiveReader::ArchiveReader() : m_file(nullptr), m_zip(false), m_end(false), m_nextEntry(0), m_tarPosition(0),
+  m_memberLeft(0), m_padding(0), m_size(0), m_stream(nullptr)
+{
+}
+
+ArchiveReader::~ArchiveReader()
+{
+  close();
+}
+
+bool ArchiveReader::open(const openstudio::path &path, std::string &message)
+{
+  close();
+  m_path = path;
+  m_file = std::fopen(path.string().c_str(), "rb");
+  if(!m_file) {
+    message = "Failed to open '" + path.string() + "'";
+    return false;
+  }
+  unsigned char magic[4] = {0, 0, 0, 0};
+  std::size_t n = std::fread(magic, 1, 4, m_file);
+  std::rewind(m_file);
+  // A local file header, or the end of central directory of an empty archive
+  if(n == 4 && magic[0] == 'P' && magic[1] == 'K' && ((magic[2] == 3 && magic[3] == 4) || (magic[2] == 5 && magic[3] == 6))) {
+    m_zip = true;
+    if(!openZip(message)) {
+      close();
+      return false;
+    }
+    return true;
+  }
+  if(!openTar(message)) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void ArchiveReader::close()
+{
+  m_stream.rdbuf(nullptr);
+  m_member.reset();
+  m_compressedTar.close();
+  if(m_file) {
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+  m_zip = false;
+  m_end = false;
+  m_entries.clear();
+  m_entryIndex.clear();
+  m_nextEntry = 0;
+  m_tarOffsets.clear();
+  m_tarPosition = 0;
+  m_memberLeft = 0;
+  m_padding = 0;
+  m_name.clear();
+  m_size = 0;
+  m_memberError.clear();
+  m_error.clear();
+}
+
+bool ArchiveReader::openZip(std::string &message)
+{
+  std::string where = "'" + m_path.string() + "'";
+  // The end of central directory record is at the end, before a comment of
+  // up to 64 KB
+  boost::uint64_t size = fileSize(m_file);
+  std::size_t tailSize = (std::size_t)std::min<boost::uint64_t>(size, 22 + 65535);
+  std::vector<unsigned char> tail(tailSize);
+  if(tailSize < 22 || !seekFile(m_file, size - tailSize) || std::fread(&tail[0], 1, tailSize, m_file) != tailSize) {
+    message = "Failed to read the end of the zip archive " + where;
+    return false;
+  }
+  std::size_t eocd = tailSize - 22 + 1;
+  while(eocd-- > 0) {
+    if(little(&tail[eocd], 4) == 0x06054b50) {
+      break;
+    }
+  }
+  if(eocd == (std::size_t)-1) {
+    message = where + " is not a complete zip archive, it has no central directory";
+    return false;
+  }
+  boost::uint64_t count = little(&tail[eocd + 10], 2);
+  boost::uint64_t directorySize = little(&tail[eocd + 12], 4);
+  boost::uint64_t directoryOffset = little(&tail[eocd + 16], 4);
+  if(count == 0xffff || directorySize == 0xffffffff || directoryOffset == 0xffffffff) {
+    // Zip64, the real values are in a record found through a locator that
+    // sits just before the end of central directory record
+    boost::uint64_t locator = size - tailSize + eocd - 20;
+    unsigned char record[56];
+    if(eocd + size - tailSize < 20 || !seekFile(m_file, locator) || std::fread(record, 1, 20, m_file) != 20
+      || little(record, 4) != 0x07064b50 || !seekFile(m_file, little(record + 8, 8))
+      || std::fread(record, 1, 56, m_file) != 56 || little(record, 4) != 0x06064b50) {
+      message = "Failed to read the zip64 directory of " + where;
+      return false;
+    }
+    count = little(record + 32, 8);
+    directorySize = little(record + 40, 8);
+    directoryOffset = little(record + 48, 8);
+  }
+
+  std::vector<unsigned char> directory((std::size_t)directorySize);
+  if(directoryOffset + directorySize > size || (directorySize && (!seekFile(m_file, directoryOffset)
+    || std::fread(&directory[0], 1, directory.size(), m_file) != directory.size()))) {
+    message = "Failed to read the central directory of " + where;
+    return false;
+  }
+  std::size_t pos = 0;
+  for(boost::uint64_t i=0;i<count;i++) {
+    if(pos + 46 > directory.size() || little(&directory[pos], 4) != 0x02014b50) {
+      message = "The central directory of " + where + " is corrupt";
+      return false;
+    }
+    const unsigned char *entry = &directory[pos];
+    std::size_t nameSize = (std::size_t)little(entry + 28, 2);
+    std::size_t extraSize = (std::size_t)little(entry + 30, 2);
+    std::size_t commentSize = (std::size_t)little(entry + 32, 2);
+    if(pos + 46 + nameSize + extraSize + commentSize > directory.size()) {
+      message = "The central directory of " + where + " is corrupt";
+      return false;
+    }
+    ZipEntry zipEntry;
+    zipEntry.name.assign((const char*)entry + 46, nameSize);
+    zipEntry.encrypted = (little(entry + 8, 2) & 1) != 0;
+    zipEntry.method = (int)little(entry + 10, 2);
+    zipEntry.crc = (boost::uint32_t)little(entry + 16, 4);
+    zipEntry.compressedSize = little(entry + 20, 4);
+    zipEntry.size = little(entry + 24, 4);
+    zipEntry.offset = little(entry + 42, 4);
+    // Fields too large for the entry are in the zip64 extra field, in this
+    // order and only if they overflowed
+    const unsigned char *extra = entry + 46 + nameSize;
+    const unsigned char *extraEnd = extra + extraSize;
+    while(extra + 4 <= extraEnd) {
+      std::size_t fieldSize = (std::size_t)little(extra + 2, 2);
+      if(little(extra, 2) == 0x0001) {
+        const unsigned char *field = extra + 4;
+        const unsigned char *fieldEnd = std::min(field + fieldSize, extraEnd);
+        if(zipEntry.size == 0xffffffff && field + 8 <= fieldEnd) {
+          zipEntry.size = little(field, 8);
+          field += 8;
+        }
+        if(zipEntry.compressedSize == 0xffffffff && field + 8 <= fieldEnd) {
+          zipEntry.compressedSize = little(field, 8);
+          field += 8;
+        }
+        if(zipEntry.offset == 0xffffffff && field + 8 <= fieldEnd) {
+          zipEntry.offset = little(field, 8);
+        }
+      }
+      extra += 4 + fieldSize;
+    }
+    pos += 46 + nameSize + extraSize + commentSize;
+    // Directories are entries with a name ending in a slash
+    if(zipEntry.name.empty() || zipEntry.name[zipEntry.name.size() - 1] == '/') {
+      continue;
+    }
+    if(m_entryIndex.find(zipEntry.name) == m_entryIndex.end()) {
+      m_entryIndex[zipEntry.name] = m_entries.size();
+    }
+    m_entries.push_back(zipEntry);
+  }
+  return true;
+}
+
+bool ArchiveReader::openZipMember(std::size_t index)
+{
+  const ZipEntry &entry = m_entries[index];
+  m_nextEntry = index + 1;
+  m_name = entry.name;
+  m_size = entry.size;
+  m_stream.rdbuf(nullptr);
+  m_member.reset();
+  m_stream.clear();
+  m_memberError.clear();
+  // A member that cannot be read is still a member, the failure is only
+  // seen by whoever tries to read it
+  if(entry.encrypted) {
+    m_memberError = "Member '" + entry.name + "' is encrypted";
+    return true;
+  }
+  if(entry.method != 0 && entry.method != 8) {
+    m_memberError = "Member '" + entry.name + "' is compressed with an unsupported method ("
+      + std::to_string(entry.method) + ")";
+    return true;
+  }
+  // The data follows the local header, whose name and extra field need not
+  // be the same length as in the central directory
+  unsigned char header[30];
+  if(!seekFile(m_file, entry.offset) || std::fread(header, 1, 30, m_file) != 30 || little(header, 4) != 0x04034b50
+    || !seekFile(m_file, entry.offset + 30 + little(header + 26, 2) + little(header + 28, 2))) {
+    m_memberError = "Failed to find the data of member '" + entry.name + "'";
+    return true;
+  }
+  m_member.reset(new ZipMemberBuffer(m_file, entry.method, entry.compressedSize, entry.size, entry.crc));
+  m_stream.rdbuf(m_member.get());
+  return true;
+}
+
+bool ArchiveReader::openTar(std::string &message)
+{
+  std::string where = "'" + m_path.string() + "'";
+  unsigned char magic[4] = {0, 0, 0, 0};
+  std::size_t n = std::fread(magic, 1, 4, m_file);
+  std::rewind(m_file);
+  if(n >= 2 && ((magic[0] == 0x1f && magic[1] == 0x8b)
+    || (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd))) {
+    // The whole archive is compressed, so it is read through a stream
+    std::fclose(m_file);
+    m_file = nullptr;
+    if(!m_compressedTar.open(m_path, message)) {
+      return false;
+    }
+  }
+  // The first block has to be a tar header or the end of an empty archive
+  char block[512];
+  if(!readTar(block, 512)) {
+    message = where + " is not a zip or tar archive";
+    return false;
+  }
+  unsigned long sum = 0;
+  bool empty = true;
+  for(int i=0;i<512;i++) {
+    sum += (i >= 148 && i < 156) ? ' ' : (unsigned char)block[i];
+    empty = empty && !block[i];
+  }
+  if(!empty && std::strtoul(std::string(block + 148, 8).c_str(), nullptr, 8) != sum) {
+    message = where + " is not a zip or tar archive";
+    return false;
+  }
+  // Start again from the beginning
+  m_tarPosition = 0;
+  if(m_file) {
+    std::rewind(m_file);
+    return true;
+  }
+  return m_compressedTar.open(m_path, message);
+}
+
+bool ArchiveReader::readTar(char *data, std::size_t size)
+{
+  bool read;
+  if(m_file) {
+    read = std::fread(data, 1, size, m_file) == size;
+  } else {
+    read = (bool)m_compressedTar.stream().read(data, size);
+  }
+  if(!read) {
+    if(m_file ? std::ferror(m_file) != 0 : !m_compressedTar.error().empty()) {
+      m_error = m_file ? "Failed to read the archive" : m_compressedTar.error();
+    } else {
+      m_error = "Archive is truncated";
+    }
+    return false;
+  }
+  m_tarPosition += size;
+  return true;
+}
+
+bool ArchiveReader::skipTar(boost::uint64_t size)
+{
+  if(m_file) {
+    if(!seekFile(m_file, m_tarPosition + size)) {
+      m_error = "Failed to read the archive";
+      return false;
+    }
+    m_tarPosition += size;
+    return true;
+  }
+  char block[4096];
+  while(size) {
+    std::size_t n = (std::size_t)std::min<boost::uint64_t>(size, sizeof(block));
+    if(!readTar(block, n)) {
+      return false;
+    }
+    size -= n;
+  }
+  return true;
+}
+
+static bool tarNumber(const char *field, std::size_t size, boost::uint64_t &value)
+{
+  value = 0;
+  // GNU tar stores numbers too large for octal in base 256, flagged by the
+  // top bit of the first byte
+  if((unsigned char)field[0] & 0x80) {
+    value = (unsigned char)field[0] & 0x7f;
+    for(std::size_t i=1;i<size;i++) {
+      value = (value << 8) | (unsigned char)field[i];
+    }
+    return true;
+  }
+  std::size_t i = 0;
+  while(i < size && field[i] == ' ') {
+    ++i;
+  }
+  for(;i<size && field[i] >= '0' && field[i] <= '7';i++) {
+    value = (value << 3) | (field[i] - '0');
+  }
+  return i == size || !field[i] || field[i] == ' ';
+}
+
+static std::string tarString(const char *field, std::size_t size)
+{
+  return std::string(field, std::find(field, field + size, '\0'));
+}
+
+bool ArchiveReader::nextTar()
+{
+  std::string longName;
+  boost::uint64_t start = m_tarPosition;
+  while(true) {
+    char block[512];
+    if(!readTar(block, 512)) {
+      return false;
+    }
+    if(std::count(block, block + 512, '\0') == 512) {
+      m_end = true;
+      return false;
+    }
+    unsigned long sum = 0;
+    for(int i=0;i<512;i++) {
+      sum += (i >= 148 && i < 156) ? ' ' : (unsigned char)block[i];
+    }
+    boost::uint64_t size, checksum;
+    if(!tarNumber(block + 148, 8, checksum) || checksum != sum || !tarNumber(block + 124, 12, size)) {
+      return fail("Corrupt tar header at offset " + std::to_string(m_tarPosition - 512));
+    }
+    boost::uint64_t padding = (512 - size % 512) % 512;
+    char type = block[156];
+    if(type == 'L' || type == 'x') {
+      // A GNU long name or pax extended header for the next entry
+      std::string data((std::size_t)size, '\0');
+      if((size && !readTar(&data[0], (std::size_t)size)) || !skipTar(padding)) {
+        return false;
+      }
+      if(type == 'L') {
+        longName = tarString(data.data(), data.size());
+        continue;
+      }
+      // Records are "length key=value\n"
+      std::size_t pos = 0;
+      while(pos < data.size()) {
+        std::size_t length = (std::size_t)std::strtoul(data.c_str() + pos, nullptr, 10);
+        if(!length || pos + length > data.size()) {
+          break;
+        }
+        std::string record = data.substr(pos, length);
+        std::size_t space = record.find(' ');
+        std::size_t equals = record.find('=');
+        if(space != std::string::npos && equals != std::string::npos && record.compare(space + 1, equals - space - 1, "path") == 0) {
+          longName = record.substr(equals + 1, record.size() - equals - 2);
+        }
+        pos += length;
+      }
+      continue;
+    }
+    if(type != '0' && type != '\0' && type != '7') {
+      // Directories, links, devices and global headers have no member data
+      // to read, any data they do have is skipped
+      if(!skipTar(size + padding)) {
+        return false;
+      }
+      longName.clear();
+      start = m_tarPosition;
+      continue;
+    }
+    if(longName.empty()) {
+      longName = tarString(block, 100);
+      // Only POSIX ustar has a prefix, old GNU headers keep other fields there
+      if(!std::memcmp(block + 257, "ustar", 6) && block[345]) {
+        longName = tarString(block + 345, 155) + "/" + longName;
+      }
+    }
+    m_name = longName;
+    m_size = size;
+    m_memberLeft = size;
+    m_padding = padding;
+    if(m_tarOffsets.find(m_name) == m_tarOffsets.end()) {
+      m_tarOffsets[m_name] = start;
+    }
+    m_member.reset(new TarMemberBuffer(*this));
+    m_stream.rdbuf(m_member.get());
+    return true;
+  }
+}
+
+bool ArchiveReader::next()
+{
+  if(!m_error.empty() || m_end) {
+    return false;
+  }
+  if(m_zip) {
+    if(m_nextEntry >= m_entries.size()) {
+      m_stream.rdbuf(nullptr);
+      m_member.reset();
+      m_memberError.clear();
+      m_end = true;
+      return false;
+    }
+    return openZipMember(m_nextEntry);
+  }
+  m_stream.rdbuf(nullptr);
+  m_member.reset();
+  m_stream.clear();
+  // Skip whatever is left of the current member
+  if(!skipTar(m_memberLeft + m_padding)) {
+    return false;
+  }
+  m_memberLeft = 0;
+  m_padding = 0;
+  return nextTar();
+}
+
+bool ArchiveReader::find(const std::string &name)
+{
+  if(!m_error.empty()) {
+    return false;
+  }
+  if(m_zip) {
+    auto found = m_entryIndex.find(name);
+    return found != m_entryIndex.end() && openZipMember(found->second);
+  }
+  auto found = m_tarOffsets.find(name);
+  if(m_file && found != m_tarOffsets.end()) {
+    // Go straight back to a member that has been seen before
+    m_stream.rdbuf(nullptr);
+    m_member.reset();
+    m_stream.clear();
+    m_memberLeft = 0;
+    m_padding = 0;
+    m_end = false;
+    if(!seekFile(m_file, found->second)) {
+      return fail("Failed to read the archive");
+    }
+    m_tarPosition = found->second;
+    return nextTar();
+  }
+  while(next()) {
+    if(m_name == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const openstudio::path &ArchiveReader::path() const
+{
+  return m_path;
+}
+
+const std::string &ArchiveReader::name() const
+{
+  return m_name;
+}
+
+boost::uint64_t ArchiveReader::size() const
+{
+  return m_size;
+}
+
+std::istream &ArchiveReader::stream()
+{
+  return m_stream;
+}
+
+std::string ArchiveReader::error() const
+{
+  ZipMemberBuffer *buffer = dynamic_cast<ZipMemberBuffer*>(m_member.get());
+  if(buffer && !buffer->error().empty()) {
+    return buffer->error();
+  }
+  if(!m_memberError.empty()) {
+    return m_memberError;
+  }
+  return m_error;
+}
+
+bool ArchiveReader::fail(const std::string &message)
+{
+  m_error = message;
+  return false;
+}
+
+bool isArchivePath(const openstudio::path &path)
+{
+  std::string name = boost::algorithm::to_lower_copy(path.filename().string());
+  const char *extensions[] = {".zip", ".tar", ".tgz", ".tzst", ".tar.gz", ".tar.zst"};
+  for(const char *extension : extensions) {
+    if(boost::algorithm::ends_with(name, extension) && name.size() > std::strlen(extension)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool splitArchiveMember(const std::string &reference, openstudio::path &archive, std::string &member)
+{
+  // Archive names may contain the separator too, the archive is the first
+  // prefix that names one
+  for(std::size_t pos=reference.find(ARCHIVE_MEMBER_SEPARATOR);pos!=std::string::npos;
+    pos=reference.find(ARCHIVE_MEMBER_SEPARATOR, pos + 1)) {
+    if(pos + 1 < reference.size() && isArchivePath(openstudio::toPath(reference.substr(0, pos)))) {
+      archive = openstudio::toPath(reference.substr(0, pos));
+      member = reference.substr(pos + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string archiveMemberReference(const openstudio::path &archive, const std::string &member)
+{
+  return archive.string() + ARCHIVE_MEMBER_SEPARATOR + member;
+}
+
+bool walkArchive(const openstudio::path &archive, const std::string &extension,
+  const std::function<bool(const std::string &reference)> &found, std::string &message)
+{
+  ArchiveReader reader;
+  if(!reader.open(archive, message)) {
+    return false;
+  }
+  while(reader.next()) {
+    if(boost::algorithm::iequals(openstudio::toPath(reader.name()).extension().string(), extension)
+      && !found(archiveMemberReference(archive, reader.name()))) {
+      return true;
+    }
+  }
+  if(!reader.error().empty()) {
+    message = "Failed to read '" + archive.string() + "': " + reader.error();
+    return false;
+  }
+  return true;
+}
+
+ArchiveReader *openArchiveMember(const std::string &reference, std::string &message)
+{
+  static thread_local std::unique_ptr<ArchiveReader> reader;
+  openstudio::path archive;
+  std::string member;
+  if(!splitArchiveMember(reference, archive, member)) {
+    message = "'" + reference + "' does not name a member of an archive";
+    return nullptr;
+  }
+  // The archive is opened again if the member is not found from where the
+  // reader is, a compressed tar archive cannot go back
+  for(int attempt=0;attempt<2;attempt++) {
+    if(!reader || reader->path() != archive || attempt) {
+      reader.reset(new ArchiveReader);
+      if(!reader->open(archive, message)) {
+        reader.reset();
+        return nullptr;
+      }
+    }
+    if(reader->find(member)) {
+      return reader.get();
+    }
+    if(!reader->error().empty()) {
+      message = reader->error();
+      reader.reset();
+      return nullptr;
+    }
+  }
+  message = "'" + archive.string() + "' has no member '" + member + "'";
+  return nullptr;
+}
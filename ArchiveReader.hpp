@@ -0,0 +1,153 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#ifndef ARCHIVEREADER_HPP
+#define ARCHIVEREADER_HPP
+
+#include "StreamIO.hpp"
+
+#include <utilities/core/Path.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <cstdio>
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** A member of an archive is named by the path of the archive and the name
+ *  of the member separated by this character, as in weather.zip!USA/x.epw. */
+const char ARCHIVE_MEMBER_SEPARATOR = '!';
+
+/** ArchiveReader reads the members of a zip or tar archive as streams, one
+ *  after another or by name, without extracting anything to disk. Zip members
+ *  may be stored or deflated, and are found through the central directory,
+ *  including the zip64 one of archives past 4 GB. Tar archives may be gzip or
+ *  zstd compressed as a whole, and may use GNU or pax long names. Reading an
+ *  uncompressed tar seeks past the members that are not read, a compressed
+ *  one has to be decompressed all the way through. Only regular files are
+ *  seen as members, directories, links and the like are skipped. */
+class ArchiveReader
+{
+public:
+  ArchiveReader();
+  ~ArchiveReader();
+
+  /** Open an archive, telling zip from tar by its contents. */
+  bool open(const openstudio::path &path, std::string &message);
+  void close();
+
+  /** Move on to the next member. Returns false at the end of the archive or
+   *  if it cannot be read, error says which. */
+  bool next();
+  /** Move to the member with the given name. A compressed tar archive is
+   *  searched from the current member on, so finding members in archive order
+   *  takes one pass over it, the members of other archives are found without
+   *  reading the members in between. */
+  bool find(const std::string &name);
+
+  /** Path of the open archive. */
+  const openstudio::path &path() const;
+  /** Name of the current member. */
+  const std::string &name() const;
+  /** Uncompressed size of the current member. */
+  boost::uint64_t size() const;
+  /** Contents of the current member, good until the reader moves on. */
+  std::istream &stream();
+  /** Description of the failure that stopped reading, or that keeps the
+   *  current member from being read, if any. */
+  std::string error() const;
+
+private:
+  ArchiveReader(const ArchiveReader&);
+  ArchiveReader& operator=(const ArchiveReader&);
+
+  struct ZipEntry
+  {
+    std::string name;
+    boost::uint64_t compressedSize;
+    boost::uint64_t size;
+    boost::uint64_t offset;
+    boost::uint32_t crc;
+    int method;
+    bool encrypted;
+  };
+
+  bool openZip(std::string &message);
+  bool openZipMember(std::size_t index);
+  bool openTar(std::string &message);
+  bool nextTar();
+  bool readTar(char *data, std::size_t size);
+  bool skipTar(boost::uint64_t size);
+  bool fail(const std::string &message);
+
+  friend class TarMemberBuffer;
+
+  openstudio::path m_path;
+  FILE *m_file;
+  bool m_zip;
+  bool m_end;
+  std::vector<ZipEntry> m_entries;
+  std::map<std::string, std::size_t> m_entryIndex;
+  std::size_t m_nextEntry;
+  InputFile m_compressedTar;
+  /** Offsets of the headers of the tar members seen so far, for going back
+   *  to one in an uncompressed archive. */
+  std::map<std::string, boost::uint64_t> m_tarOffsets;
+  boost::uint64_t m_tarPosition;
+  boost::uint64_t m_memberLeft;
+  boost::uint64_t m_padding;
+  std::string m_name;
+  boost::uint64_t m_size;
+  std::unique_ptr<std::streambuf> m_member;
+  std::istream m_stream;
+  std::string m_memberError;
+  std::string m_error;
+};
+
+/** True if a path names a zip or tar archive: .zip, .tar, .tgz or .tar with
+ *  a compressed file extension. */
+bool isArchivePath(const openstudio::path &path);
+
+/** Split a member reference, archive!member, into the archive path and the
+ *  member name. Returns false if the reference does not name a member. */
+bool splitArchiveMember(const std::string &reference, openstudio::path &archive, std::string &member);
+
+/** Reference to a member of an archive. */
+std::string archiveMemberReference(const openstudio::path &archive, const std::string &member);
+
+/** Call found with the reference of every regular member of an archive with
+ *  the given extension, in archive order, as the archive is read. Stops early
+ *  if found returns false. Returns false and sets message if the archive
+ *  cannot be read. */
+bool walkArchive(const openstudio::path &archive, const std::string &extension,
+  const std::function<bool(const std::string &reference)> &found, std::string &message);
+
+/** Open a member named by a reference with a reader kept for the calling
+ *  thread, so that a thread reading the members of a tar archive in order
+ *  makes one pass over it rather than one per member. The reader, positioned
+ *  at the member, is good until the next call on the same thread. Returns
+ *  null and sets message on failure. */
+ArchiveReader *openArchiveMember(const std::string &reference, std::string &message);
+
+#endif // ARCHIVEREADER_HPP
@@ -0,0 +1,153 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#include "CheckReport.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+// Quote a CSV field if it has to be
+static std::string csvField(const std::string &field)
+{
+  if(field.find_first_of(",\"\r\n") == std::string::npos) {
+    return field;
+  }
+  std::string quoted = "\"";
+  for(char c : field) {
+    if(c == '"') {
+      quoted += '"';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+double percentile(std::vector<double> &values, double percent)
+{
+  if(values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  std::size_t rank = (std::size_t)std::ceil(percent/100.0*values.size());
+  return values[std::max<std::size_t>(rank, 1) - 1];
+}
+
+CheckReport::CheckReport() : m_jsonLines(false)
+{
+}
+
+bool CheckReport::open(const openstudio::path &path, bool jsonLines, std::string &message)
+{
+  m_path = path;
+  m_jsonLines = jsonLines;
+  m_stream.open(path.string().c_str(), std::ios_base::out | std::ios_base::trunc);
+  if(!m_stream) {
+    message = "Failed to open report file '" + path.string() + "'";
+    return false;
+  }
+  if(!m_jsonLines) {
+    m_stream << "path,tier,status,shared,bytes,rows,seconds,peak_memory_growth_bytes" << std::endl;
+  }
+  return true;
+}
+
+CheckReport::Tier &CheckReport::tier(const std::string &name)
+{
+  for(Tier &tier : m_tiers) {
+    if(tier.name == name) {
+      return tier;
+    }
+  }
+  m_tiers.push_back(Tier());
+  m_tiers.back().name = name;
+  return m_tiers.back();
+}
+
+void CheckReport::add(const CheckTiming &timing)
+{
+  Tier &summary = tier(timing.tier);
+  ++summary.files;
+  if(timing.failed) {
+    ++summary.failed;
+  }
+  summary.bytes += timing.bytes;
+  if(!timing.shared) {
+    summary.seconds.push_back(timing.seconds);
+  }
+  if(!m_stream.is_open()) {
+    return;
+  }
+  if(m_jsonLines) {
+    m_stream << "{\"path\":\"" << jsonEscape(timing.path) << "\",\"tier\":\"" << jsonEscape(timing.tier)
+      << "\",\"status\":\"" << (timing.failed ? "fail" : "pass") << "\",\"shared\":" << (timing.shared ? "true" : "false")
+      << ",\"bytes\":" << timing.bytes << ",\"rows\":" << timing.rows << ",\"seconds\":" << timing.seconds
+      << ",\"peak_memory_growth_bytes\":" << timing.memoryGrowth << "}\n";
+  } else {
+    m_stream << csvField(timing.path) << "," << timing.tier << "," << (timing.failed ? "fail" : "pass") << ","
+      << (timing.shared ? 1 : 0) << "," << timing.bytes << "," << timing.rows << "," << timing.seconds << ","
+      << timing.memoryGrowth << "\n";
+  }
+}
+
+bool CheckReport::finish(double wallSeconds, std::string &message)
+{
+  if(!m_stream.is_open()) {
+    return true;
+  }
+  double wall = std::max(wallSeconds, 1e-9);
+  for(Tier &summary : m_tiers) {
+    double p50 = percentile(summary.seconds, 50);
+    double p95 = percentile(summary.seconds, 95);
+    double p99 = percentile(summary.seconds, 99);
+    if(m_jsonLines) {
+      m_stream << "{\"summary\":true,\"tier\":\"" << jsonEscape(summary.name) << "\",\"files\":" << summary.files
+        << ",\"failed\":" << summary.failed << ",\"bytes\":" << summary.bytes << ",\"wall_seconds\":" << wallSeconds
+        << ",\"files_per_second\":" << summary.files/wall << ",\"mb_per_second\":" << summary.bytes/1048576.0/wall
+        << ",\"p50_seconds\":" << p50 << ",\"p95_seconds\":" << p95 << ",\"p99_seconds\":" << p99 << "}\n";
+    } else {
+      m_stream << "# summary tier=" << summary.name << " files=" << summary.files << " failed=" << summary.failed
+        << " bytes=" << summary.bytes << " wall_seconds=" << wallSeconds << " files_per_second=" << summary.files/wall
+        << " mb_per_second=" << summary.bytes/1048576.0/wall << " p50_seconds=" << p50 << " p95_seconds=" << p95
+        << " p99_seconds=" << p99 << "\n";
+    }
+  }
+  m_stream.close();
+  if(!m_stream) {
+    message = "Failed to write report file '" + m_path.string() + "'";
+    return false;
+  }
+  return true;
+}
+
+std::string CheckReport::summaryText(double wallSeconds) const
+{
+  std::ostringstream text;
+  double wall = std::max(wallSeconds, 1e-9);
+  for(const Tier &summary : m_tiers) {
+    std::vector<double> seconds = summary.seconds;
+    text << (summary.name.empty() ? "Checked " : "Checked (" + summary.name + ") ") << summary.files << " files, "
+      << summary.bytes/1048576.0 << " MB in " << wallSeconds << " s: " << summary.files/wall << " files/s, "
+      << summary.bytes/1048576.0/wall << " MB/s, latency p50 " << 1000.0*percentile(seconds, 50) << " ms, p95 "
+      << 1000.0*percentile(seconds, 95) << " ms, p99 " << 1000.0*percentile(seconds, 99) << " ms" << std::endl;
+  }
+  return text.str();
+}
@@ -0,0 +1,93 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#ifndef CHECKREPORT_HPP
+#define CHECKREPORT_HPP
+
+#include <utilities/core/Path.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/** What it took to check one file: its size, the data records read, the
+ *  time taken and how much the process's peak memory grew meanwhile. A check
+ *  answered by the verdict for an identical file is marked shared and took
+ *  no time of its own. */
+struct CheckTiming
+{
+  CheckTiming() : failed(false), shared(false), bytes(0), rows(0), seconds(0), memoryGrowth(0)
+  {}
+  std::string path;
+  std::string tier;
+  bool failed;
+  bool shared;
+  boost::uint64_t bytes;
+  boost::uint64_t rows;
+  double seconds;
+  boost::uint64_t memoryGrowth;
+};
+
+/** CheckReport writes a row for every check of a run, passing or failing,
+ *  as CSV or JSON Lines, and ends with a summary of each tier: files and
+ *  bytes checked per second of the run and the 50th, 95th and 99th
+ *  percentile check times. In CSV the summary follows the rows as comment
+ *  lines starting with #, in JSON Lines it is a last object with "summary"
+ *  set. Shared checks count towards the throughput but not the percentiles. */
+class CheckReport
+{
+public:
+  CheckReport();
+
+  bool open(const openstudio::path &path, bool jsonLines, std::string &message);
+  /** Write the row for a check. */
+  void add(const CheckTiming &timing);
+  /** Write the summary and close the report. */
+  bool finish(double wallSeconds, std::string &message);
+  /** The summary as lines of text, for the console. */
+  std::string summaryText(double wallSeconds) const;
+
+private:
+  struct Tier
+  {
+    Tier() : files(0), failed(0), bytes(0)
+    {}
+    std::string name;
+    unsigned files;
+    unsigned failed;
+    boost::uint64_t bytes;
+    std::vector<double> seconds;
+  };
+
+  Tier &tier(const std::string &name);
+
+  openstudio::path m_path;
+  bool m_jsonLines;
+  std::ofstream m_stream;
+  std::vector<Tier> m_tiers;
+};
+
+/** Value below which a given percentage of the values fall, by the nearest
+ *  rank method, zero if there are none. The values are sorted in place. */
+double percentile(std::vector<double> &values, double percent);
+
+#endif // CHECKREPORT_HPP
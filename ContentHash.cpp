@@ -0,0 +1,141 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "ContentHash.hpp"
+#include "EpwReader.hpp"
+
+#include <cstring>
+#include <vector>
+
+static const boost::uint64_t multiplier = 0xc6a4a7935bd1e995ULL;
+static const int shift = 47;
+
+static inline boost::uint64_t loadWord(const unsigned char *data)
+{
+  // Assemble little endian so the hash is the same on every platform
+  boost::uint64_t k = 0;
+  for(int i=7;i>=0;i--) {
+    k = (k << 8) | data[i];
+  }
+  return k;
+}
+
+ContentHash::ContentHash(boost::uint64_t seed) : m_hash(seed), m_size(0), m_tailSize(0)
+{
+}
+
+void ContentHash::mix(boost::uint64_t k)
+{
+  k *= multiplier;
+  k ^= k >> shift;
+  k *= multiplier;
+  m_hash ^= k;
+  m_hash *= multiplier;
+}
+
+void ContentHash::update(const char *data, std::size_t size)
+{
+  const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+  const unsigned char *end = p + size;
+  m_size += size;
+  if(m_tailSize) {
+    while(m_tailSize < 8 && p < end) {
+      m_tail[m_tailSize++] = *p++;
+    }
+    if(m_tailSize < 8) {
+      return;
+    }
+    mix(loadWord(m_tail));
+    m_tailSize = 0;
+  }
+  for(; end - p >= 8; p += 8) {
+    mix(loadWord(p));
+  }
+  while(p < end) {
+    m_tail[m_tailSize++] = *p++;
+  }
+}
+
+void ContentHash::update(const std::string &data)
+{
+  update(data.data(), data.size());
+}
+
+boost::uint64_t ContentHash::digest() const
+{
+  boost::uint64_t h = m_hash;
+  if(m_tailSize) {
+    boost::uint64_t k = 0;
+    for(std::size_t i=m_tailSize;i>0;i--) {
+      k = (k << 8) | m_tail[i-1];
+    }
+    h ^= k;
+    h *= multiplier;
+  }
+  h ^= m_size*multiplier;
+  h ^= h >> shift;
+  h *= multiplier;
+  h ^= h >> shift;
+  return h;
+}
+
+boost::uint64_t ContentHash::size() const
+{
+  return m_size;
+}
+
+std::string ContentHash::toHex(boost::uint64_t hash)
+{
+  static const char digits[] = "0123456789abcdef";
+  std::string hex(16, '0');
+  for(int i=15;i>=0;i--) {
+    hex[i] = digits[hash & 0xf];
+    hash >>= 4;
+  }
+  return hex;
+}
+
+bool hashFile(const openstudio::path &path, boost::uint64_t &hash, boost::uint64_t &size, std::string &message)
+{
+  MappedFile file;
+  if(!file.open(path, message)) {
+    return false;
+  }
+  ContentHash hasher;
+  hasher.update(file.data(), file.size());
+  hash = hasher.digest();
+  size = hasher.size();
+  return true;
+}
+
+bool hashStream(std::istream &stream, boost::uint64_t &hash, boost::uint64_t &size, std::string &message)
+{
+  ContentHash hasher;
+  std::vector<char> buffer(1 << 16);
+  while(stream.read(&buffer[0], buffer.size()) || stream.gcount()) {
+    hasher.update(&buffer[0], (std::size_t)stream.gcount());
+  }
+  if(stream.bad()) {
+    message = "Failed to read input";
+    return false;
+  }
+  hash = hasher.digest();
+  size = hasher.size();
+  return true;
+}
@@ -0,0 +1,69 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef CONTENTHASH_HPP
+#define CONTENTHASH_HPP
+
+#include <utilities/core/Path.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <cstddef>
+#include <istream>
+#include <string>
+
+/** ContentHash computes a fast 64 bit non-cryptographic hash of a byte
+ *  sequence, eight bytes at a time (a streaming variant of MurmurHash64A).
+ *  Data may be added in pieces of any size; the result only depends on the
+ *  bytes, not on how they were split up. It is meant for spotting changed or
+ *  duplicated files, not for security. */
+class ContentHash
+{
+public:
+  explicit ContentHash(boost::uint64_t seed=0);
+
+  void update(const char *data, std::size_t size);
+  void update(const std::string &data);
+
+  /** Hash of everything added so far. */
+  boost::uint64_t digest() const;
+  /** Number of bytes added so far. */
+  boost::uint64_t size() const;
+
+  /** Hash formatted as 16 hexadecimal digits. */
+  static std::string toHex(boost::uint64_t hash);
+
+private:
+  void mix(boost::uint64_t k);
+
+  boost::uint64_t m_hash;
+  boost::uint64_t m_size;
+  unsigned char m_tail[8];
+  std::size_t m_tailSize;
+};
+
+/** Hash the contents of a file. Returns false and sets message if the file
+ *  cannot be read. */
+bool hashFile(const openstudio::path &path, boost::uint64_t &hash, boost::uint64_t &size, std::string &message);
+
+/** Hash everything left in a stream. Returns false and sets message if the
+ *  stream goes bad before its end. */
+bool hashStream(std::istream &stream, boost::uint64_t &hash, boost::uint64_t &size, std::string &message);
+
+#endif // CONTENTHASH_HPP
@@ -0,0 +1,392 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "EpwCache.hpp"
+#include "ContentHash.hpp"
+#include "StreamIO.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+static const char cacheMagic[4] = {'E','P','W','C'};
+static const boost::uint32_t cacheByteOrder = 0x01020304;
+static const boost::uint32_t cacheVersion = 1;
+
+enum ColumnType
+{
+  NoColumn = 0,
+  Float32Column = 4,
+  Float64Column = 8
+};
+
+// The fixed part of a cache file, every member is naturally aligned
+struct CacheFileHeader
+{
+  char magic[4];
+  boost::uint32_t byteOrder;
+  boost::uint32_t version;
+  boost::uint32_t fields;
+  boost::uint64_t sourceHash;
+  boost::uint64_t sourceSize;
+  boost::uint64_t records;
+  boost::int32_t recordsPerHour;
+  boost::int32_t startDayOfWeek;
+  boost::int32_t startMonth;
+  boost::int32_t startDay;
+  boost::int32_t endMonth;
+  boost::int32_t endDay;
+  boost::int32_t leapYear;
+  boost::int32_t reserved;
+  double latitude;
+  double longitude;
+  double timeZone;
+  double elevation;
+  boost::uint64_t headerTextOffset;
+  boost::uint64_t headerTextSize;
+  boost::uint64_t columnOffset[EPW_FIELDS];
+  boost::uint32_t columnType[EPW_FIELDS];
+};
+
+static boost::uint64_t alignTo8(boost::uint64_t offset)
+{
+  return (offset + 7) & ~(boost::uint64_t)7;
+}
+
+EpwCacheWriter::EpwCacheWriter()
+{
+}
+
+bool EpwCacheWriter::header(const EpwHeader &header, std::string &message)
+{
+  m_header = header;
+  std::size_t expected = (std::size_t)header.numberOfDays()*24*header.recordsPerHour;
+  for(std::vector<double> &column : m_columns) {
+    column.clear();
+    column.reserve(expected);
+  }
+  return true;
+}
+
+bool EpwCacheWriter::record(const EpwRecord &record, std::string &message)
+{
+  for(int i=0;i<EPW_FIELDS;i++) {
+    m_columns[i].push_back(record.values[i]);
+  }
+  return true;
+}
+
+static ColumnType columnType(int field, const std::vector<double> &column)
+{
+  if(field == EpwDataSource) {
+    return NoColumn;
+  }
+  for(double value : column) {
+    if(value == value && (double)(float)value != value) {
+      return Float64Column;
+    }
+  }
+  return Float32Column;
+}
+
+bool EpwCacheWriter::write(const openstudio::path &path, boost::uint64_t sourceHash, boost::uint64_t sourceSize,
+  std::string &message) const
+{
+  CacheFileHeader fileHeader;
+  std::memset(&fileHeader, 0, sizeof(fileHeader));
+  std::memcpy(fileHeader.magic, cacheMagic, sizeof(cacheMagic));
+  fileHeader.byteOrder = cacheByteOrder;
+  fileHeader.version = cacheVersion;
+  fileHeader.fields = EPW_FIELDS;
+  fileHeader.sourceHash = sourceHash;
+  fileHeader.sourceSize = sourceSize;
+  fileHeader.records = m_columns[0].size();
+  fileHeader.recordsPerHour = m_header.recordsPerHour;
+  fileHeader.startDayOfWeek = m_header.startDayOfWeek;
+  fileHeader.startMonth = m_header.startMonth;
+  fileHeader.startDay = m_header.startDay;
+  fileHeader.endMonth = m_header.endMonth;
+  fileHeader.endDay = m_header.endDay;
+  fileHeader.leapYear = m_header.leapYear ? 1 : 0;
+  fileHeader.latitude = m_header.latitude;
+  fileHeader.longitude = m_header.longitude;
+  fileHeader.timeZone = m_header.timeZone;
+  fileHeader.elevation = m_header.elevation;
+
+  std::string headerText;
+  for(const std::string &line : m_header.lines) {
+    headerText += line + "\n";
+  }
+  fileHeader.headerTextOffset = sizeof(CacheFileHeader);
+  fileHeader.headerTextSize = headerText.size();
+
+  boost::uint64_t offset = alignTo8(fileHeader.headerTextOffset + fileHeader.headerTextSize);
+  for(int i=0;i<EPW_FIELDS;i++) {
+    fileHeader.columnType[i] = columnType(i, m_columns[i]);
+    fileHeader.columnOffset[i] = offset;
+    offset = alignTo8(offset + fileHeader.columnType[i]*fileHeader.records);
+  }
+
+  // The process id keeps other processes off the file and the counter keeps
+  // other threads, which may be writing the same cache, off it
+  static std::atomic<unsigned long> tempCount(0);
+  openstudio::path tempPath = path;
+  tempPath += openstudio::toPath(".tmp" + boost::lexical_cast<std::string>(getpid()) + "-"
+    + boost::lexical_cast<std::string>(tempCount++));
+  std::ofstream file(tempPath.string().c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+  if(!file) {
+    message = "Could not open cache file '" + openstudio::toString(tempPath) + "'";
+    return false;
+  }
+
+  static const char padding[8] = {0,0,0,0,0,0,0,0};
+  boost::uint64_t position = 0;
+  file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+  file.write(headerText.data(), headerText.size());
+  position += sizeof(fileHeader) + headerText.size();
+  std::vector<float> singles;
+  for(int i=0;i<EPW_FIELDS;i++) {
+    file.write(padding, fileHeader.columnOffset[i] - position);
+    position = fileHeader.columnOffset[i];
+    if(fileHeader.columnType[i] == Float64Column) {
+      file.write(reinterpret_cast<const char*>(m_columns[i].data()), m_columns[i].size()*sizeof(double));
+    } else if(fileHeader.columnType[i] == Float32Column) {
+      singles.assign(m_columns[i].begin(), m_columns[i].end());
+      file.write(reinterpret_cast<const char*>(singles.data()), singles.size()*sizeof(float));
+    }
+    position += fileHeader.columnType[i]*fileHeader.records;
+  }
+  file.write(padding, offset - position);
+  file.close();
+
+  boost::system::error_code ec;
+  if(!file) {
+    boost::filesystem::remove(tempPath, ec);
+    message = "Failed to write cache file '" + openstudio::toString(path) + "'";
+    return false;
+  }
+  boost::filesystem::rename(tempPath, path, ec);
+  if(ec) {
+    boost::filesystem::remove(tempPath, ec);
+    message = "Failed to move cache file into place at '" + openstudio::toString(path) + "'";
+    return false;
+  }
+  return true;
+}
+
+EpwCache::EpwCache() : m_sourceHash(0), m_sourceSize(0), m_records(0)
+{
+  close();
+}
+
+bool EpwCache::open(const openstudio::path &path, std::string &message)
+{
+  close();
+  if(!m_file.open(path, message)) {
+    return false;
+  }
+  std::string invalid = "'" + openstudio::toString(path) + "' is not a valid EPW cache";
+  CacheFileHeader fileHeader;
+  if(m_file.size() < sizeof(fileHeader)) {
+    message = invalid;
+    return false;
+  }
+  std::memcpy(&fileHeader, m_file.data(), sizeof(fileHeader));
+  if(std::memcmp(fileHeader.magic, cacheMagic, sizeof(cacheMagic)) || fileHeader.byteOrder != cacheByteOrder
+    || fileHeader.fields != EPW_FIELDS) {
+    message = invalid;
+    return false;
+  }
+  if(fileHeader.version != cacheVersion) {
+    message = "'" + openstudio::toString(path) + "' was written by a different version of the EPW cache";
+    return false;
+  }
+  if(fileHeader.headerTextOffset + fileHeader.headerTextSize > m_file.size()) {
+    message = invalid;
+    return false;
+  }
+  for(int i=0;i<EPW_FIELDS;i++) {
+    boost::uint32_t type = fileHeader.columnType[i];
+    if(type != NoColumn && type != Float32Column && type != Float64Column) {
+      message = invalid;
+      return false;
+    }
+    if(fileHeader.columnOffset[i] % 8 || fileHeader.columnOffset[i] + type*fileHeader.records > m_file.size()) {
+      message = invalid;
+      return false;
+    }
+    m_types[i] = type;
+    m_columns[i] = type == NoColumn ? nullptr : m_file.data() + fileHeader.columnOffset[i];
+  }
+
+  // The header text is parsed again rather than trusting the copies of the
+  // numbers in the fixed header, it is only eight lines
+  std::vector<std::string> lines;
+  const char *text = m_file.data() + fileHeader.headerTextOffset;
+  const char *end = text + fileHeader.headerTextSize;
+  while(text < end) {
+    const char *newline = static_cast<const char*>(std::memchr(text, '\n', end - text));
+    if(!newline) {
+      newline = end;
+    }
+    lines.push_back(std::string(text, newline));
+    text = newline + 1;
+  }
+  if(!m_header.parse(lines, message)) {
+    message = invalid + ": " + message;
+    return false;
+  }
+
+  m_sourceHash = fileHeader.sourceHash;
+  m_sourceSize = fileHeader.sourceSize;
+  m_records = (unsigned long)fileHeader.records;
+  return true;
+}
+
+void EpwCache::close()
+{
+  m_file.close();
+  m_sourceHash = 0;
+  m_sourceSize = 0;
+  m_records = 0;
+  for(int i=0;i<EPW_FIELDS;i++) {
+    m_columns[i] = nullptr;
+    m_types[i] = NoColumn;
+  }
+}
+
+const EpwHeader &EpwCache::header() const
+{
+  return m_header;
+}
+
+boost::uint64_t EpwCache::sourceHash() const
+{
+  return m_sourceHash;
+}
+
+boost::uint64_t EpwCache::sourceSize() const
+{
+  return m_sourceSize;
+}
+
+unsigned long EpwCache::records() const
+{
+  return m_records;
+}
+
+double EpwCache::value(unsigned long record, EpwField field) const
+{
+  if(m_types[field] == Float64Column) {
+    double value;
+    std::memcpy(&value, m_columns[field] + record*sizeof(double), sizeof(double));
+    return value;
+  } else if(m_types[field] == Float32Column) {
+    float value;
+    std::memcpy(&value, m_columns[field] + record*sizeof(float), sizeof(float));
+    return value;
+  }
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+bool EpwCache::replay(EpwRecordHandler &handler, std::string &message) const
+{
+  if(!handler.header(m_header, message)) {
+    return false;
+  }
+  EpwRecord record;
+  record.flags = "";
+  record.flagsLength = 0;
+  for(unsigned long i=0;i<m_records;i++) {
+    for(int j=0;j<EPW_FIELDS;j++) {
+      record.values[j] = value(i, (EpwField)j);
+    }
+    if(!handler.record(record, message)) {
+      return false;
+    }
+  }
+  return handler.finish(message);
+}
+
+openstudio::path epwCachePath(const openstudio::path &epwPath)
+{
+  openstudio::path path = stripCompressionExtension(epwPath);
+  return path.replace_extension(openstudio::toPath("epwc").string());
+}
+
+bool writeEpwCache(const openstudio::path &epwPath, const openstudio::path &cachePath, std::string &message)
+{
+  // A compressed EPW is tagged with the hash of the file as stored
+  if(isCompressedPath(epwPath)) {
+    boost::uint64_t hash, size;
+    if(!hashFile(epwPath, hash, size, message)) {
+      return false;
+    }
+    EpwCacheWriter writer;
+    if(!parseEpwInput(epwPath, writer, message)) {
+      return false;
+    }
+    return writer.write(cachePath, hash, size, message);
+  }
+
+  MappedFile file;
+  if(!file.open(epwPath, message)) {
+    return false;
+  }
+  ContentHash hash;
+  hash.update(file.data(), file.size());
+
+  EpwCacheWriter writer;
+  EpwParser parser(writer);
+  if(!parser.parse(file.data(), file.size())) {
+    message = parser.message();
+    return false;
+  }
+  return writer.write(cachePath, hash.digest(), hash.size(), message);
+}
+
+bool openEpwCache(const openstudio::path &epwPath, const openstudio::path &cachePath, EpwCache &cache,
+  bool &rebuilt, std::string &message)
+{
+  rebuilt = false;
+  boost::uint64_t hash, size;
+  if(!hashFile(epwPath, hash, size, message)) {
+    return false;
+  }
+  if(cache.open(cachePath, message) && cache.sourceHash() == hash && cache.sourceSize() == size) {
+    return true;
+  }
+  rebuilt = true;
+  cache.close();
+  if(!writeEpwCache(epwPath, cachePath, message)) {
+    return false;
+  }
+  return cache.open(cachePath, message);
+}
@@ -0,0 +1,107 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef EPWCACHE_HPP
+#define EPWCACHE_HPP
+
+#include "EpwReader.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <string>
+#include <vector>
+
+/** An EPW cache (.epwc) is a binary, column-oriented copy of the data in an
+ *  EPW file. It starts with a fixed header that holds the content hash and
+ *  size of the source EPW, the location, the data period and the offset and
+ *  element type of each column, followed by the original header text and then
+ *  one contiguous array per EPW field. A column is stored as float32 when
+ *  every value in it converts exactly, otherwise as float64, so the cache is
+ *  lossless. The data source flags field is not stored. Caches are written in
+ *  the byte order of the machine that wrote them and are rejected elsewhere. */
+
+/** EpwCacheWriter collects parsed EPW records into columns and writes them
+ *  out as a cache. */
+class EpwCacheWriter : public EpwRecordHandler
+{
+public:
+  EpwCacheWriter();
+
+  virtual bool header(const EpwHeader &header, std::string &message);
+  virtual bool record(const EpwRecord &record, std::string &message);
+
+  /** Write the cache, tagged with the hash and size of the source EPW. The
+   *  file is written under a temporary name and then renamed into place. */
+  bool write(const openstudio::path &path, boost::uint64_t sourceHash, boost::uint64_t sourceSize,
+    std::string &message) const;
+
+private:
+  EpwHeader m_header;
+  std::vector<double> m_columns[EPW_FIELDS];
+};
+
+/** EpwCache gives access to a cache file mapped into memory. */
+class EpwCache
+{
+public:
+  EpwCache();
+
+  /** Map a cache and check that it is well formed. */
+  bool open(const openstudio::path &path, std::string &message);
+  /** Unmap the cache. */
+  void close();
+
+  const EpwHeader &header() const;
+  boost::uint64_t sourceHash() const;
+  boost::uint64_t sourceSize() const;
+  unsigned long records() const;
+
+  /** Value of a field in a record, NaN if the field is not stored. */
+  double value(unsigned long record, EpwField field) const;
+
+  /** Pass the header and every record to a handler, as EpwParser would. */
+  bool replay(EpwRecordHandler &handler, std::string &message) const;
+
+private:
+  EpwCache(const EpwCache&);
+  EpwCache& operator=(const EpwCache&);
+
+  MappedFile m_file;
+  EpwHeader m_header;
+  boost::uint64_t m_sourceHash;
+  boost::uint64_t m_sourceSize;
+  unsigned long m_records;
+  const char *m_columns[EPW_FIELDS];
+  unsigned m_types[EPW_FIELDS];
+};
+
+/** Cache path that goes with an EPW file, the same path with extension .epwc.
+ *  A compressed EPW shares its cache with the uncompressed file. */
+openstudio::path epwCachePath(const openstudio::path &epwPath);
+
+/** Parse an EPW file, which may be compressed, and write its cache. */
+bool writeEpwCache(const openstudio::path &epwPath, const openstudio::path &cachePath, std::string &message);
+
+/** Open the cache for an EPW file, checking it against the EPW's content hash.
+ *  If the cache is missing, unreadable or out of date it is rebuilt. Sets
+ *  rebuilt to report whether that happened. */
+bool openEpwCache(const openstudio::path &epwPath, const openstudio::path &cachePath, EpwCache &cache,
+  bool &rebuilt, std::string &message);
+
+#endif // EPWCACHE_HPP
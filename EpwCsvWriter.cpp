@@ -0,0 +1,76 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#include "EpwCsvWriter.hpp"
+
+#include <cstdio>
+
+CsvRecordWriter::CsvRecordWriter(std::ostream &csv) : m_csv(csv)
+{
+}
+
+bool CsvRecordWriter::header(const EpwHeader &, std::string &)
+{
+  for(int i=0;i<EPW_FIELDS;i++) {
+    if(i) {
+      m_csv << ",";
+    }
+    m_csv << epwFieldName((EpwField)i);
+  }
+  m_csv << "\n";
+  return true;
+}
+
+bool CsvRecordWriter::record(const EpwRecord &record, std::string &message)
+{
+  char buffer[64];
+  for(int i=0;i<EPW_FIELDS;i++) {
+    if(i) {
+      m_csv.put(',');
+    }
+    if(i == EpwDataSource) {
+      if(record.flags) {
+        m_csv.write(record.flags, record.flagsLength);
+      }
+      continue;
+    }
+    double value = record.values[i];
+    if(value == value) {
+      int n = std::snprintf(buffer, sizeof(buffer), "%.10g", value);
+      m_csv.write(buffer, n);
+    }
+  }
+  m_csv.put('\n');
+  if(!m_csv) {
+    message = "Failed to write CSV output";
+    return false;
+  }
+  return true;
+}
+
+bool CsvRecordWriter::finish(std::string &message)
+{
+  m_csv.flush();
+  if(!m_csv) {
+    message = "Failed to write CSV output";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,46 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#ifndef EPWCSVWRITER_HPP
+#define EPWCSVWRITER_HPP
+
+#include "EpwReader.hpp"
+
+#include <ostream>
+#include <string>
+
+/** CsvRecordWriter writes parsed EPW records to a stream as CSV: a row of
+ *  field names followed by one row per record, with every field in file order.
+ *  Missing fields are left empty. Numbers are written back as parsed, so a
+ *  field with leading zeros (such as the present weather codes) loses them. */
+class CsvRecordWriter : public EpwRecordHandler
+{
+public:
+  explicit CsvRecordWriter(std::ostream &csv);
+
+  virtual bool header(const EpwHeader &header, std::string &message);
+  virtual bool record(const EpwRecord &record, std::string &message);
+  virtual bool finish(std::string &message);
+
+private:
+  std::ostream &m_csv;
+};
+
+#endif // EPWCSVWRITER_HPP
@@ -0,0 +1,211 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "EpwHeader.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+static const int daysInMonth[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+
+static int monthLength(int month, bool leapYear)
+{
+  if(month == 2 && leapYear) {
+    return 29;
+  }
+  return daysInMonth[month-1];
+}
+
+int epwDayOfYear(int month, int day, bool leapYear)
+{
+  if(month < 1 || month > 12 || day < 1 || day > monthLength(month, leapYear)) {
+    return 0;
+  }
+  int dayOfYear = day;
+  for(int i=1;i<month;i++) {
+    dayOfYear += monthLength(i, leapYear);
+  }
+  return dayOfYear;
+}
+
+void epwMonthDay(int dayOfYear, int &month, int &day, bool leapYear)
+{
+  int length = leapYear ? 366 : 365;
+  dayOfYear = (dayOfYear - 1)%length + 1;
+  month = 1;
+  while(month < 12 && dayOfYear > monthLength(month, leapYear)) {
+    dayOfYear -= monthLength(month, leapYear);
+    ++month;
+  }
+  day = dayOfYear;
+}
+
+void chompCarriageReturn(std::string &line)
+{
+  if(!line.empty() && line[line.size()-1] == '\r') {
+    line.erase(line.size()-1);
+  }
+}
+
+static bool toDouble(const std::string &string, double &value)
+{
+  try {
+    value = boost::lexical_cast<double>(boost::algorithm::trim_copy(string));
+  } catch(boost::bad_lexical_cast&) {
+    return false;
+  }
+  return true;
+}
+
+static bool toMonthDay(const std::string &string, int &month, int &day, bool leapYear)
+{
+  std::vector<std::string> parts;
+  boost::algorithm::split(parts, string, boost::algorithm::is_any_of("/"));
+  if(parts.size() < 2 || parts.size() > 3) {
+    return false;
+  }
+  try {
+    month = boost::lexical_cast<int>(boost::algorithm::trim_copy(parts[0]));
+    day = boost::lexical_cast<int>(boost::algorithm::trim_copy(parts[1]));
+  } catch(boost::bad_lexical_cast&) {
+    return false;
+  }
+  return epwDayOfYear(month, day, leapYear) != 0;
+}
+
+static int toDayOfWeek(const std::string &string)
+{
+  static const char *names[7] = {"Sunday","Monday","Tuesday","Wednesday","Thursday","Friday","Saturday"};
+  std::string name = boost::algorithm::trim_copy(string);
+  for(int i=0;i<7;i++) {
+    if(boost::algorithm::iequals(name, names[i])) {
+      return i+1;
+    }
+  }
+  return 0;
+}
+
+EpwHeader::EpwHeader() : latitude(0.0), longitude(0.0), timeZone(0.0), elevation(0.0), leapYear(false), recordsPerHour(1),
+  startDayOfWeek(1), startMonth(1), startDay(1), endMonth(12), endDay(31)
+{
+}
+
+bool EpwHeader::parse(const std::vector<std::string> &headerLines, std::string &message)
+{
+  if(headerLines.size() != (std::size_t)EPW_HEADER_LINES) {
+    message = "Expected " + boost::lexical_cast<std::string>(EPW_HEADER_LINES) + " header lines";
+    return false;
+  }
+  lines = headerLines;
+
+  std::vector<std::string> fields;
+  boost::algorithm::split(fields, lines[0], boost::algorithm::is_any_of(","));
+  if(fields.size() < 10 || !boost::algorithm::iequals(fields[0], "LOCATION")) {
+    message = "Malformed LOCATION header line";
+    return false;
+  }
+  city = fields[1];
+  stateProvinceRegion = fields[2];
+  country = fields[3];
+  dataSource = fields[4];
+  wmo = fields[5];
+  if(!toDouble(fields[6], latitude) || !toDouble(fields[7], longitude)
+    || !toDouble(fields[8], timeZone) || !toDouble(fields[9], elevation)) {
+    message = "Non-numeric value in LOCATION header line";
+    return false;
+  }
+
+  boost::algorithm::split(fields, lines[4], boost::algorithm::is_any_of(","));
+  leapYear = fields.size() > 1 && boost::algorithm::iequals(boost::algorithm::trim_copy(fields[1]), "Yes");
+
+  boost::algorithm::split(fields, lines[7], boost::algorithm::is_any_of(","));
+  if(fields.size() < 7 || !boost::algorithm::iequals(fields[0], "DATA PERIODS")) {
+    message = "Malformed DATA PERIODS header line";
+    return false;
+  }
+  double value;
+  if(!toDouble(fields[2], value) || value < 1 || value > 60) {
+    message = "Invalid number of records per hour in DATA PERIODS header line";
+    return false;
+  }
+  recordsPerHour = (int)value;
+  startDayOfWeek = toDayOfWeek(fields[4]);
+  if(!startDayOfWeek) {
+    message = "Invalid start day of week '" + fields[4] + "' in DATA PERIODS header line";
+    return false;
+  }
+  if(!toMonthDay(fields[5], startMonth, startDay, leapYear) || !toMonthDay(fields[6], endMonth, endDay, leapYear)) {
+    message = "Invalid start or end date in DATA PERIODS header line";
+    return false;
+  }
+  return true;
+}
+
+bool EpwHeader::read(std::istream &stream, std::string &message)
+{
+  std::vector<std::string> headerLines(EPW_HEADER_LINES);
+  for(std::string &line : headerLines) {
+    if(!std::getline(stream, line)) {
+      message = "File ended before the end of the header";
+      return false;
+    }
+    chompCarriageReturn(line);
+  }
+  return parse(headerLines, message);
+}
+
+int EpwHeader::numberOfDays() const
+{
+  int start = epwDayOfYear(startMonth, startDay, leapYear);
+  int end = epwDayOfYear(endMonth, endDay, leapYear);
+  if(end < start) {
+    end += leapYear ? 366 : 365;
+  }
+  return end - start + 1;
+}
+
+int EpwHeader::startDayOfYear() const
+{
+  return epwDayOfYear(startMonth, startDay, leapYear);
+}
+
+int EpwHeader::dayOfPeriod(int month, int day) const
+{
+  int dayOfYear = epwDayOfYear(month, day, leapYear);
+  if(!dayOfYear) {
+    return -1;
+  }
+  int offset = dayOfYear - startDayOfYear();
+  if(offset < 0) {
+    offset += leapYear ? 366 : 365;
+  }
+  if(offset >= numberOfDays()) {
+    return -1;
+  }
+  return offset;
+}
+
+EpwHeader EpwHeader::slice(int firstDay, int lastDay) const
+{
+  EpwHeader header(*this);
+  epwMonthDay(startDayOfYear() + firstDay, header.startMonth, header.startDay, leapYear);
+  epwMonthDay(startDayOfYear() + lastDay, header.endMonth, header.endDay, leapYear);
+  header.startDayOfWeek = (startDayOfWeek - 1 + firstDay)%7 + 1;
+  return header;
+}
@@ -0,0 +1,86 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef EPWHEADER_HPP
+#define EPWHEADER_HPP
+
+#include <istream>
+#include <string>
+#include <vector>
+
+/** EpwHeader holds the eight header lines of an EPW file along with the
+ *  pieces of the LOCATION and DATA PERIODS lines that the translators need.
+ *  Only the first data period is used. Days of the week are numbered from
+ *  1 (Sunday) to 7 (Saturday). */
+struct EpwHeader
+{
+  EpwHeader();
+
+  /** Parse the eight header lines, returns false and sets message on failure. */
+  bool parse(const std::vector<std::string> &headerLines, std::string &message);
+  /** Read the eight header lines from a stream and parse them. */
+  bool read(std::istream &stream, std::string &message);
+
+  /** Number of days from the start date through the end date, inclusive. */
+  int numberOfDays() const;
+  /** Day of year of the start date. */
+  int startDayOfYear() const;
+  /** Days from the start date to a month and day, or -1 if the date is not
+   *  in the data period. */
+  int dayOfPeriod(int month, int day) const;
+  /** Copy of the header with the data period cut down to the days from
+   *  firstDay through lastDay, counted from the start date. */
+  EpwHeader slice(int firstDay, int lastDay) const;
+
+  std::vector<std::string> lines;
+
+  std::string city;
+  std::string stateProvinceRegion;
+  std::string country;
+  std::string dataSource;
+  std::string wmo;
+  double latitude;
+  double longitude;
+  double timeZone;
+  double elevation;
+
+  bool leapYear;
+
+  int recordsPerHour;
+  int startDayOfWeek;
+  int startMonth;
+  int startDay;
+  int endMonth;
+  int endDay;
+};
+
+/** Number of header lines in an EPW file. */
+const int EPW_HEADER_LINES = 8;
+
+/** Day of year of a month and day. Returns zero if the date is not valid. */
+int epwDayOfYear(int month, int day, bool leapYear=false);
+
+/** Month and day of a day of year. Days past the end of the year wrap around
+ *  to the start of the year. */
+void epwMonthDay(int dayOfYear, int &month, int &day, bool leapYear=false);
+
+/** Remove a trailing carriage return left behind by getline on CRLF files. */
+void chompCarriageReturn(std::string &line);
+
+#endif // EPWHEADER_HPP
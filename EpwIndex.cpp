@@ -0,0 +1,284 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#include "EpwIndex.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+static const char *EPW_INDEX_VERSION = "1";
+
+static bool isBlankLine(const char *begin, const char *end)
+{
+  for(const char *p=begin;p<end;p++) {
+    if(*p != ' ' && *p != '\t' && *p != '\r') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parse the header at the start of a mapped file, setting position to the
+// start of the data
+static bool readHeader(const char *data, std::size_t size, EpwHeader &header, std::size_t &position,
+  std::string &message)
+{
+  std::vector<std::string> lines;
+  const char *p = data;
+  const char *end = data + size;
+  while(lines.size() < (std::size_t)EPW_HEADER_LINES && p < end) {
+    const char *newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    const char *lineEnd = newline ? newline : end;
+    lines.push_back(std::string(p, lineEnd));
+    chompCarriageReturn(lines.back());
+    p = newline ? newline + 1 : end;
+  }
+  if(lines.size() < (std::size_t)EPW_HEADER_LINES) {
+    message = "File ended before the end of the header";
+    return false;
+  }
+  position = p - data;
+  return header.parse(lines, message);
+}
+
+EpwDayIndex::EpwDayIndex() : sourceSize(0), sourceTime(0)
+{
+}
+
+bool EpwDayIndex::build(const char *data, std::size_t size, std::string &message)
+{
+  offsets.clear();
+  EpwHeader header;
+  std::size_t position;
+  if(!readHeader(data, size, header, position, message)) {
+    return false;
+  }
+
+  unsigned long perDay = 24ul*header.recordsPerHour;
+  unsigned long expected = perDay*header.numberOfDays();
+  unsigned long records = 0;
+  const char *p = data + position;
+  const char *end = data + size;
+  while(p < end && records < expected) {
+    const char *newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    const char *lineEnd = newline ? newline : end;
+    if(!isBlankLine(p, lineEnd)) {
+      if(records % perDay == 0) {
+        offsets.push_back(p - data);
+      }
+      ++records;
+    }
+    p = newline ? newline + 1 : end;
+  }
+  if(records < expected) {
+    message = "Found " + boost::lexical_cast<std::string>(records) + " data records, expected "
+      + boost::lexical_cast<std::string>(expected) + " for the data period";
+    offsets.clear();
+    return false;
+  }
+  offsets.push_back(p - data);
+  return true;
+}
+
+bool EpwDayIndex::read(const openstudio::path &indexPath)
+{
+  offsets.clear();
+  std::ifstream file(indexPath.string().c_str());
+  if(!file) {
+    return false;
+  }
+  bool haveVersion = false, haveSource = false;
+  std::string line;
+  while(std::getline(file, line)) {
+    std::string::size_type equals = line.find('=');
+    if(equals == std::string::npos) {
+      continue;
+    }
+    std::string key = line.substr(0, equals);
+    std::string value = line.substr(equals+1);
+    if(key == "version") {
+      haveVersion = value == EPW_INDEX_VERSION;
+    } else if(key == "source") {
+      std::istringstream stream(value);
+      long long time;
+      haveSource = static_cast<bool>(stream >> sourceSize >> time);
+      sourceTime = (std::time_t)time;
+    } else if(key == "offsets") {
+      std::size_t count;
+      std::istringstream stream(value);
+      if(!(stream >> count)) {
+        return false;
+      }
+      offsets.resize(count);
+      for(std::size_t i=0;i<count;i++) {
+        if(!(file >> offsets[i])) {
+          offsets.clear();
+          return false;
+        }
+      }
+    }
+  }
+  return haveVersion && haveSource && offsets.size() > 1;
+}
+
+bool EpwDayIndex::write(const openstudio::path &indexPath, std::string &message) const
+{
+  std::ofstream file(indexPath.string().c_str(), std::ios_base::out | std::ios_base::trunc);
+  file << "version=" << EPW_INDEX_VERSION << "\n";
+  file << "source=" << sourceSize << " " << (long long)sourceTime << "\n";
+  file << "offsets=" << offsets.size() << "\n";
+  for(boost::uint64_t offset : offsets) {
+    file << offset << "\n";
+  }
+  file.close();
+  if(!file) {
+    message = "Failed to write index file '" + openstudio::toString(indexPath) + "'";
+    return false;
+  }
+  return true;
+}
+
+bool EpwDayIndex::matches(const openstudio::path &epwPath) const
+{
+  boost::system::error_code ec;
+  boost::uint64_t size = boost::filesystem::file_size(epwPath, ec);
+  if(ec || size != sourceSize) {
+    return false;
+  }
+  std::time_t time = boost::filesystem::last_write_time(epwPath, ec);
+  return !ec && time == sourceTime;
+}
+
+int EpwDayIndex::days() const
+{
+  return offsets.empty() ? 0 : (int)offsets.size() - 1;
+}
+
+openstudio::path epwIndexPath(const openstudio::path &epwPath)
+{
+  openstudio::path path = epwPath;
+  return path.replace_extension(openstudio::toPath("epwi").string());
+}
+
+bool openEpwDayIndex(const openstudio::path &epwPath, const MappedFile &file, EpwDayIndex &index,
+  std::string &message)
+{
+  openstudio::path indexPath = epwIndexPath(epwPath);
+  if(index.read(indexPath) && index.matches(epwPath) && index.offsets.back() <= file.size()) {
+    return true;
+  }
+
+  boost::system::error_code ec;
+  index.sourceSize = file.size();
+  index.sourceTime = boost::filesystem::last_write_time(epwPath, ec);
+  if(!index.build(file.data(), file.size(), message)) {
+    return false;
+  }
+  std::string writeMessage;
+  if(!ec) {
+    index.write(indexPath, writeMessage);
+  }
+  return true;
+}
+
+// Month and day of the data record that starts at data. The mapped file is
+// not terminated, so nothing here reads past end.
+static bool recordDate(const char *data, const char *end, int &month, int &day)
+{
+  const char *first = static_cast<const char*>(std::memchr(data, ',', end - data));
+  if(!first) {
+    return false;
+  }
+  const char *second = static_cast<const char*>(std::memchr(first + 1, ',', end - first - 1));
+  if(!second) {
+    return false;
+  }
+  const char *third = static_cast<const char*>(std::memchr(second + 1, ',', end - second - 1));
+  if(!third) {
+    return false;
+  }
+  double monthValue, dayValue;
+  if(!parseEpwNumber(first + 1, second, monthValue) || !parseEpwNumber(second + 1, third, dayValue)
+    || monthValue != monthValue || dayValue != dayValue) {
+    return false;
+  }
+  month = (int)monthValue;
+  day = (int)dayValue;
+  return true;
+}
+
+bool sliceEpw(const MappedFile &file, const EpwDayIndex &index, int startMonth, int startDay, int endMonth,
+  int endDay, EpwSlice &slice, std::string &message)
+{
+  EpwHeader header;
+  std::size_t position;
+  if(!readHeader(file.data(), file.size(), header, position, message)) {
+    return false;
+  }
+  if(index.days() != header.numberOfDays() || index.offsets.back() > file.size()) {
+    message = "Day index does not match the data period";
+    return false;
+  }
+
+  int first = startMonth ? header.dayOfPeriod(startMonth, startDay) : 0;
+  if(first < 0) {
+    message = "Start date " + boost::lexical_cast<std::string>(startMonth) + "/"
+      + boost::lexical_cast<std::string>(startDay) + " is not in the data period";
+    return false;
+  }
+  int last = endMonth ? header.dayOfPeriod(endMonth, endDay) : header.numberOfDays() - 1;
+  if(last < 0) {
+    message = "End date " + boost::lexical_cast<std::string>(endMonth) + "/"
+      + boost::lexical_cast<std::string>(endDay) + " is not in the data period";
+    return false;
+  }
+  if(last < first) {
+    message = "End date comes before the start date in the data period";
+    return false;
+  }
+  slice.header = header.slice(first, last);
+
+  // A cheap check that the index still lines up with the file
+  const char *begin = file.data() + index.offsets[first];
+  int month, day;
+  if(!recordDate(begin, file.data() + file.size(), month, day) || month != slice.header.startMonth
+    || day != slice.header.startDay) {
+    message = "Day index is out of date, remove it and try again";
+    return false;
+  }
+
+  slice.data = begin;
+  slice.size = index.offsets[last+1] - index.offsets[first];
+  return true;
+}
+
+bool parseMonthDay(const std::string &string, int &month, int &day)
+{
+  char extra;
+  if(std::sscanf(string.c_str(), "%d/%d%c", &month, &day, &extra) != 2) {
+    return false;
+  }
+  return epwDayOfYear(month, day, true) != 0;
+}
@@ -0,0 +1,95 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#ifndef EPWINDEX_HPP
+#define EPWINDEX_HPP
+
+#include "EpwHeader.hpp"
+#include "EpwReader.hpp"
+
+#include <utilities/core/Path.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+/** EpwDayIndex holds the byte offset of the first data record of each day in
+ *  the data period of an EPW file, plus the offset of the end of the data, so
+ *  that a range of days can be read without reading the days before it. The
+ *  index is kept in a small text file next to the EPW (same path, extension
+ *  .epwi) along with the size and modification time of the EPW it was built
+ *  from. Checking those is cheap, unlike hashing the file, which would cost
+ *  as much as reading it. */
+struct EpwDayIndex
+{
+  EpwDayIndex();
+
+  /** Build the index from the contents of an EPW file. The file must hold a
+   *  full day of records (24 times the records per hour) for every day of its
+   *  data period. */
+  bool build(const char *data, std::size_t size, std::string &message);
+
+  /** Read an index file, returns false if it is missing or cannot be read. */
+  bool read(const openstudio::path &indexPath);
+  /** Write the index file. */
+  bool write(const openstudio::path &indexPath, std::string &message) const;
+
+  /** True if the index was built from the file as it is now. */
+  bool matches(const openstudio::path &epwPath) const;
+
+  /** Number of days indexed. */
+  int days() const;
+
+  boost::uint64_t sourceSize;
+  std::time_t sourceTime;
+  std::vector<boost::uint64_t> offsets;
+};
+
+/** Index path that goes with an EPW file, the same path with extension .epwi. */
+openstudio::path epwIndexPath(const openstudio::path &epwPath);
+
+/** Get the day index for a mapped EPW file, reading the index file if it is
+ *  current and otherwise building it from the file and trying to save it. An
+ *  index that cannot be saved (say, in a read-only library) is still used. */
+bool openEpwDayIndex(const openstudio::path &epwPath, const MappedFile &file, EpwDayIndex &index,
+  std::string &message);
+
+/** EpwSlice is the part of a mapped EPW file that covers a range of days: a
+ *  header with the data period cut down to the range, and the data records
+ *  for those days. */
+struct EpwSlice
+{
+  EpwHeader header;
+  const char *data;
+  std::size_t size;
+};
+
+/** Find the records from one month and day through another in a mapped EPW
+ *  file using its day index. Both dates must be in the file's data period,
+ *  in order. A zero month stands for the start (or the end) of the period. */
+bool sliceEpw(const MappedFile &file, const EpwDayIndex &index, int startMonth, int startDay, int endMonth,
+  int endDay, EpwSlice &slice, std::string &message);
+
+/** Parse a date given as M/D or MM/DD. */
+bool parseMonthDay(const std::string &string, int &month, int &day);
+
+#endif // EPWINDEX_HPP
@@ -0,0 +1,624 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "EpwReader.hpp"
+#include "ContentHash.hpp"
+#include "StreamIO.hpp"
+
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EPW_USE_SSE2
+#endif
+
+#if defined(__has_include)
+#if __cplusplus >= 201703L && __has_include(<charconv>)
+#include <charconv>
+#if defined(__cpp_lib_to_chars)
+#define EPW_USE_FROM_CHARS
+#endif
+#endif
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline unsigned lowestBit(unsigned mask)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// SeparatorScanner finds the commas and newlines in a block of text. Each
+// 16 byte block is compared against both characters at once and the matches
+// are handed out from the resulting bit mask.
+class SeparatorScanner
+{
+public:
+  SeparatorScanner(const char *begin, const char *end) : m_block(begin), m_end(end), m_mask(0)
+  {
+    load();
+  }
+
+  // Return the next separator, or end if there are no more
+  const char *next()
+  {
+    while(!m_mask) {
+      m_block += 16;
+      if(m_block >= m_end) {
+        return m_end;
+      }
+      load();
+    }
+    unsigned bit = lowestBit(m_mask);
+    m_mask &= m_mask - 1;
+    return m_block + bit;
+  }
+
+private:
+  void load()
+  {
+    m_mask = 0;
+#ifdef EPW_USE_SSE2
+    if(m_end - m_block >= 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_block));
+      __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(',')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+      m_mask = (unsigned)_mm_movemask_epi8(matches);
+      return;
+    }
+#endif
+    std::ptrdiff_t n = m_end - m_block;
+    if(n > 16) {
+      n = 16;
+    }
+    for(std::ptrdiff_t i=0;i<n;i++) {
+      if(m_block[i] == ',' || m_block[i] == '\n') {
+        m_mask |= 1u << i;
+      }
+    }
+  }
+
+  const char *m_block;
+  const char *m_end;
+  unsigned m_mask;
+};
+
+static inline bool isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *epwFieldName(EpwField field)
+{
+  static const char *names[EPW_FIELDS] = {
+    "Year", "Month", "Day", "Hour", "Minute", "Data Source and Uncertainty Flags",
+    "Dry Bulb Temperature {C}", "Dew Point Temperature {C}", "Relative Humidity {%}",
+    "Atmospheric Station Pressure {Pa}", "Extraterrestrial Horizontal Radiation {Wh/m2}",
+    "Extraterrestrial Direct Normal Radiation {Wh/m2}", "Horizontal Infrared Radiation Intensity {Wh/m2}",
+    "Global Horizontal Radiation {Wh/m2}", "Direct Normal Radiation {Wh/m2}", "Diffuse Horizontal Radiation {Wh/m2}",
+    "Global Horizontal Illuminance {lux}", "Direct Normal Illuminance {lux}", "Diffuse Horizontal Illuminance {lux}",
+    "Zenith Luminance {Cd/m2}", "Wind Direction {deg}", "Wind Speed {m/s}", "Total Sky Cover {.1}",
+    "Opaque Sky Cover {.1}", "Visibility {km}", "Ceiling Height {m}", "Present Weather Observation",
+    "Present Weather Codes", "Precipitable Water {mm}", "Aerosol Optical Depth {.001}", "Snow Depth {cm}",
+    "Days Since Last Snowfall", "Albedo", "Liquid Precipitation Depth {mm}", "Liquid Precipitation Quantity {hr}"
+  };
+  if(field < 0 || field >= EPW_FIELDS) {
+    return "";
+  }
+  return names[field];
+}
+
+// Powers of ten that are exactly representable as doubles
+static const double exactPowersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+bool parseEpwNumber(const char *begin, const char *end, double &value)
+{
+  while(begin < end && isBlank(*begin)) {
+    ++begin;
+  }
+  while(end > begin && isBlank(end[-1])) {
+    --end;
+  }
+  if(begin == end) {
+    value = std::numeric_limits<double>::quiet_NaN();
+    return true;
+  }
+  if(*begin == '+') {
+    ++begin;
+  }
+
+#ifdef EPW_USE_FROM_CHARS
+  std::from_chars_result result = std::from_chars(begin, end, value);
+  return result.ec == std::errc() && result.ptr == end;
+#else
+  // Most EPW fields are short decimals, which are converted exactly here
+  // from an integer mantissa and a power of ten. Anything else goes through
+  // strtod from a stack buffer.
+  const char *p = begin;
+  bool negative = false;
+  if(p < end && *p == '-') {
+    negative = true;
+    ++p;
+  }
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  for(; p < end && *p >= '0' && *p <= '9'; ++p) {
+    any = true;
+    if(mantissa || *p != '0') {
+      mantissa = mantissa*10 + (*p - '0');
+      ++digits;
+    }
+  }
+  if(p < end && *p == '.') {
+    for(++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+      any = true;
+      if(mantissa || *p != '0') {
+        mantissa = mantissa*10 + (*p - '0');
+        ++digits;
+      }
+      --exponent;
+    }
+  }
+  if(!any) {
+    return false;
+  }
+  bool simple = p == end;
+  if(!simple && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    if(q < end && (*q == '+' || *q == '-')) {
+      ++q;
+    }
+    if(q == end || *q < '0' || *q > '9') {
+      return false;
+    }
+    for(; q < end && *q >= '0' && *q <= '9'; ++q) {
+    }
+    if(q != end) {
+      return false;
+    }
+  } else if(!simple) {
+    return false;
+  }
+
+  if(simple && digits <= 15 && exponent >= -22) {
+    value = exponent ? (double)mantissa / exactPowersOfTen[-exponent] : (double)mantissa;
+    if(negative) {
+      value = -value;
+    }
+    return true;
+  }
+
+  char buffer[64];
+  std::size_t length = end - begin;
+  if(length >= sizeof(buffer)) {
+    return false;
+  }
+  std::memcpy(buffer, begin, length);
+  buffer[length] = '\0';
+  char *stop;
+  value = std::strtod(buffer, &stop);
+  return stop == buffer + length;
+#endif
+}
+
+EpwParser::EpwParser(EpwRecordHandler &handler) : m_handler(handler), m_records(0), m_headerDone(false), m_failed(false)
+{
+  m_record.flags = nullptr;
+  m_record.flagsLength = 0;
+}
+
+bool EpwParser::fail(const std::string &message)
+{
+  m_message = message;
+  m_failed = true;
+  return false;
+}
+
+bool EpwParser::feedHeader(const char *&data, const char *end)
+{
+  while(m_headerLines.size() < (std::size_t)EPW_HEADER_LINES && data < end) {
+    const char *newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+    if(!newline) {
+      m_carry.append(data, end);
+      data = end;
+      return true;
+    }
+    m_carry.append(data, newline);
+    chompCarriageReturn(m_carry);
+    m_headerLines.push_back(m_carry);
+    m_carry.clear();
+    data = newline + 1;
+  }
+  if(m_headerLines.size() == (std::size_t)EPW_HEADER_LINES) {
+    EpwHeader header;
+    std::string message;
+    if(!header.parse(m_headerLines, message)) {
+      return fail(message);
+    }
+    if(!m_handler.header(header, message)) {
+      return fail(message);
+    }
+    m_headerDone = true;
+  }
+  return true;
+}
+
+bool EpwParser::begin(const EpwHeader &header)
+{
+  if(m_failed) {
+    return false;
+  }
+  if(m_headerDone || !m_headerLines.empty() || !m_carry.empty()) {
+    return fail("The header has already been read");
+  }
+  std::string message;
+  if(!m_handler.header(header, message)) {
+    return fail(message);
+  }
+  m_headerDone = true;
+  return true;
+}
+
+bool EpwParser::feed(const char *data, std::size_t size)
+{
+  if(m_failed) {
+    return false;
+  }
+  const char *end = data + size;
+  if(!m_headerDone) {
+    if(!feedHeader(data, end)) {
+      return false;
+    }
+    if(data == end) {
+      return true;
+    }
+  }
+
+  // Finish off a record that was split across pieces
+  if(!m_carry.empty()) {
+    const char *newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+    if(!newline) {
+      m_carry.append(data, end);
+      return true;
+    }
+    m_carry.append(data, newline + 1);
+    data = newline + 1;
+    std::string carry;
+    carry.swap(m_carry);
+    bool ok = parseRecords(carry.data(), carry.data() + carry.size());
+    carry.swap(m_carry);
+    m_carry.clear();
+    if(!ok) {
+      return false;
+    }
+  }
+
+  return parseRecords(data, end);
+}
+
+bool EpwParser::finish()
+{
+  if(m_failed) {
+    return false;
+  }
+  if(!m_headerDone) {
+    if(!m_carry.empty()) {
+      m_carry += '\n';
+      std::string carry;
+      carry.swap(m_carry);
+      const char *data = carry.data();
+      if(!feedHeader(data, data + carry.size())) {
+        return false;
+      }
+    }
+    if(!m_headerDone) {
+      return fail("File ended before the end of the header");
+    }
+  }
+  if(!m_carry.empty()) {
+    m_carry += '\n';
+    std::string carry;
+    carry.swap(m_carry);
+    if(!parseRecords(carry.data(), carry.data() + carry.size())) {
+      return false;
+    }
+  }
+  std::string message;
+  if(!m_handler.finish(message)) {
+    return fail(message);
+  }
+  return true;
+}
+
+bool EpwParser::parse(const char *data, std::size_t size)
+{
+  return feed(data, size) && finish();
+}
+
+bool EpwParser::parseRecords(const char *begin, const char *end)
+{
+  SeparatorScanner scanner(begin, end);
+  const char *recordStart = begin;
+  const char *fieldStart = begin;
+  int field = 0;
+  while(true) {
+    const char *separator = scanner.next();
+    if(separator == end) {
+      // Keep the partial record for the next piece
+      m_carry.assign(recordStart, end);
+      return true;
+    }
+    if(field < EPW_FIELDS) {
+      if(field == EpwDataSource) {
+        m_record.flags = fieldStart;
+        m_record.flagsLength = separator - fieldStart;
+      } else if(!parseEpwNumber(fieldStart, separator, m_record.values[field])) {
+        return fail("Non-numeric value '" + std::string(fieldStart, separator) + "' in field "
+          + boost::lexical_cast<std::string>(field+1) + " of data record " + boost::lexical_cast<std::string>(m_records+1));
+      }
+    }
+    ++field;
+    if(*separator == '\n') {
+      if(!completeRecord(field, recordStart, separator)) {
+        return false;
+      }
+      field = 0;
+      recordStart = separator + 1;
+    }
+    fieldStart = separator + 1;
+  }
+}
+
+bool EpwParser::completeRecord(int fields, const char *begin, const char *end)
+{
+  if(fields == 1) {
+    while(begin < end && isBlank(*begin)) {
+      ++begin;
+    }
+    if(begin == end) {
+      // Blank line
+      return true;
+    }
+  }
+  if(fields < EPW_MIN_FIELDS || fields > EPW_FIELDS) {
+    return fail("Expected " + boost::lexical_cast<std::string>((int)EPW_FIELDS) + " fields in data record "
+      + boost::lexical_cast<std::string>(m_records+1) + ", found " + boost::lexical_cast<std::string>(fields));
+  }
+  for(int i=fields;i<EPW_FIELDS;i++) {
+    m_record.values[i] = std::numeric_limits<double>::quiet_NaN();
+  }
+  ++m_records;
+  std::string message;
+  if(!m_handler.record(m_record, message)) {
+    return fail(message);
+  }
+  return true;
+}
+
+std::string EpwParser::message() const
+{
+  return m_message;
+}
+
+unsigned long EpwParser::records() const
+{
+  return m_records;
+}
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0)
+#ifdef _WIN32
+  , m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+bool MappedFile::open(const openstudio::path &path, std::string &message)
+{
+  close();
+#ifdef _WIN32
+  m_file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if(m_file == INVALID_HANDLE_VALUE) {
+    message = "Could not open '" + path.string() + "'";
+    return false;
+  }
+  LARGE_INTEGER size;
+  if(!GetFileSizeEx(m_file, &size)) {
+    message = "Could not determine the size of '" + path.string() + "'";
+    close();
+    return false;
+  }
+  m_size = (std::size_t)size.QuadPart;
+  if(!m_size) {
+    return true;
+  }
+  m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(m_mapping) {
+    m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+  }
+  if(!m_data) {
+    message = "Could not map '" + path.string() + "'";
+    close();
+    return false;
+  }
+#else
+  int fd = ::open(path.string().c_str(), O_RDONLY);
+  if(fd < 0) {
+    message = "Could not open '" + path.string() + "'";
+    return false;
+  }
+  struct stat status;
+  if(fstat(fd, &status) != 0) {
+    message = "Could not determine the size of '" + path.string() + "'";
+    ::close(fd);
+    return false;
+  }
+  m_size = (std::size_t)status.st_size;
+  if(!m_size) {
+    ::close(fd);
+    return true;
+  }
+  void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if(data == MAP_FAILED) {
+    m_size = 0;
+    message = "Could not map '" + path.string() + "'";
+    return false;
+  }
+  madvise(data, m_size, MADV_SEQUENTIAL);
+  m_data = static_cast<const char*>(data);
+#endif
+  return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+  if(m_data) {
+    UnmapViewOfFile(m_data);
+  }
+  if(m_mapping) {
+    CloseHandle(m_mapping);
+  }
+  if(m_file != INVALID_HANDLE_VALUE) {
+    CloseHandle(m_file);
+  }
+  m_mapping = nullptr;
+  m_file = INVALID_HANDLE_VALUE;
+#else
+  if(m_data) {
+    munmap(const_cast<char*>(m_data), m_size);
+  }
+#endif
+  m_data = nullptr;
+  m_size = 0;
+}
+
+const char *MappedFile::data() const
+{
+  return m_data;
+}
+
+std::size_t MappedFile::size() const
+{
+  return m_size;
+}
+
+bool parseEpwFile(const openstudio::path &path, EpwRecordHandler &handler, std::string &message,
+  ContentHash *sourceHash)
+{
+  MappedFile file;
+  if(!file.open(path, message)) {
+    return false;
+  }
+  EpwParser parser(handler);
+  if(!sourceHash) {
+    if(!parser.parse(file.data(), file.size())) {
+      message = parser.message();
+      return false;
+    }
+    return true;
+  }
+  // Hash each piece just before it is parsed, while it is still in cache
+  const std::size_t piece = 1 << 20;
+  for(std::size_t offset=0;offset<file.size();offset+=piece) {
+    std::size_t size = std::min(piece, file.size() - offset);
+    sourceHash->update(file.data() + offset, size);
+    if(!parser.feed(file.data() + offset, size)) {
+      message = parser.message();
+      return false;
+    }
+  }
+  if(!parser.finish()) {
+    message = parser.message();
+    return false;
+  }
+  return true;
+}
+
+bool parseEpwStream(std::istream &stream, EpwRecordHandler &handler, std::string &message)
+{
+  EpwParser parser(handler);
+  std::vector<char> buffer(1 << 20);
+  while(stream) {
+    stream.read(&buffer[0], buffer.size());
+    std::streamsize n = stream.gcount();
+    if(n > 0 && !parser.feed(&buffer[0], (std::size_t)n)) {
+      message = parser.message();
+      return false;
+    }
+  }
+  if(stream.bad()) {
+    message = "Failed to read EPW input";
+    return false;
+  }
+  if(!parser.finish()) {
+    message = parser.message();
+    return false;
+  }
+  return true;
+}
+
+bool parseEpwInput(const openstudio::path &path, EpwRecordHandler &handler, std::string &message,
+  ContentHash *sourceHash)
+{
+  if(!isCompressedPath(path)) {
+    return parseEpwFile(path, handler, message, sourceHash);
+  }
+  InputFile input;
+  if(!input.open(path, message, sourceHash)) {
+    return false;
+  }
+  if(!parseEpwStream(input.stream(), handler, message)) {
+    if(!input.error().empty()) {
+      message = input.error();
+    }
+    return false;
+  }
+  return true;
+}
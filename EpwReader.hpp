@@ -0,0 +1,172 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef EPWREADER_HPP
+#define EPWREADER_HPP
+
+#include "EpwHeader.hpp"
+
+#include <utilities/core/Path.hpp>
+
+class ContentHash;
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+/** Fields of an EPW data record, in file order. */
+enum EpwField
+{
+  EpwYear, EpwMonth, EpwDay, EpwHour, EpwMinute, EpwDataSource,
+  EpwDryBulbTemperature, EpwDewPointTemperature, EpwRelativeHumidity, EpwAtmosphericStationPressure,
+  EpwExtraterrestrialHorizontalRadiation, EpwExtraterrestrialDirectNormalRadiation,
+  EpwHorizontalInfraredRadiationIntensity, EpwGlobalHorizontalRadiation, EpwDirectNormalRadiation,
+  EpwDiffuseHorizontalRadiation, EpwGlobalHorizontalIlluminance, EpwDirectNormalIlluminance,
+  EpwDiffuseHorizontalIlluminance, EpwZenithLuminance, EpwWindDirection, EpwWindSpeed, EpwTotalSkyCover,
+  EpwOpaqueSkyCover, EpwVisibility, EpwCeilingHeight, EpwPresentWeatherObservation, EpwPresentWeatherCodes,
+  EpwPrecipitableWater, EpwAerosolOpticalDepth, EpwSnowDepth, EpwDaysSinceLastSnowfall, EpwAlbedo,
+  EpwLiquidPrecipitationDepth, EpwLiquidPrecipitationQuantity,
+  EPW_FIELDS
+};
+
+/** Name of a field as given in the EnergyPlus auxiliary programs documentation,
+ *  with its units. */
+const char *epwFieldName(EpwField field);
+
+/** Older EPW files stop after the days since last snowfall field. */
+const int EPW_MIN_FIELDS = EpwAlbedo;
+
+/** EpwRecord is one EPW data record with every numeric field converted to a
+ *  double. Empty and absent fields are NaN. The data source field is not
+ *  copied, flags points at it in the parser's buffer and is only valid while
+ *  the record is being handled. */
+struct EpwRecord
+{
+  double values[EPW_FIELDS];
+  const char *flags;
+  std::size_t flagsLength;
+
+  int month() const { return (int)values[EpwMonth]; }
+  int day() const { return (int)values[EpwDay]; }
+  int hour() const { return (int)values[EpwHour]; }
+  int minute() const { return (int)values[EpwMinute]; }
+};
+
+/** Interface for consumers of parsed EPW data. Returning false from any of
+ *  the functions stops parsing, the message is reported as the reason. */
+class EpwRecordHandler
+{
+public:
+  virtual ~EpwRecordHandler() {}
+
+  virtual bool header(const EpwHeader &header, std::string &message) = 0;
+  virtual bool record(const EpwRecord &record, std::string &message) = 0;
+  /** Called once all of the input has been parsed. */
+  virtual bool finish(std::string &message) { return true; }
+};
+
+/** Convert the text in [begin,end) to a double without allocating. Leading
+ *  and trailing blanks are ignored and an empty field gives NaN. */
+bool parseEpwNumber(const char *begin, const char *end, double &value);
+
+/** EpwParser splits EPW text into header lines and data records and converts
+ *  the record fields in place. Commas and newlines are located a block at a
+ *  time with SSE2 where it is available, and no memory is allocated per
+ *  record. Input may be given all at once, as for a mapped file, or in pieces
+ *  of any size, as for a decompressor or a pipe. */
+class EpwParser
+{
+public:
+  explicit EpwParser(EpwRecordHandler &handler);
+
+  /** Start with a header that has already been read, so that the input is
+   *  only data records. */
+  bool begin(const EpwHeader &header);
+  /** Parse the next piece of the input. */
+  bool feed(const char *data, std::size_t size);
+  /** Parse whatever remains once the input is exhausted. */
+  bool finish();
+  /** Parse a complete file held in memory. */
+  bool parse(const char *data, std::size_t size);
+
+  /** Description of the failure that stopped the parse. */
+  std::string message() const;
+  /** Number of data records handled so far. */
+  unsigned long records() const;
+
+private:
+  bool feedHeader(const char *&data, const char *end);
+  bool parseRecords(const char *begin, const char *end);
+  bool completeRecord(int fields, const char *begin, const char *end);
+  bool fail(const std::string &message);
+
+  EpwRecordHandler &m_handler;
+  std::vector<std::string> m_headerLines;
+  std::string m_carry;
+  EpwRecord m_record;
+  std::string m_message;
+  unsigned long m_records;
+  bool m_headerDone;
+  bool m_failed;
+};
+
+/** MappedFile maps a file read-only into memory. */
+class MappedFile
+{
+public:
+  MappedFile();
+  ~MappedFile();
+
+  bool open(const openstudio::path &path, std::string &message);
+  void close();
+
+  const char *data() const;
+  std::size_t size() const;
+
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char *m_data;
+  std::size_t m_size;
+#ifdef _WIN32
+  void *m_file;
+  void *m_mapping;
+#endif
+};
+
+/** Map an EPW file and pass its contents through a parser to handler. If
+ *  sourceHash is given, the file's bytes are added to it piece by piece as
+ *  they are parsed, so that the file is only read once. */
+bool parseEpwFile(const openstudio::path &path, EpwRecordHandler &handler, std::string &message,
+  ContentHash *sourceHash=nullptr);
+
+/** Read an EPW from a stream in large pieces and pass it through a parser to
+ *  handler. This is for input that cannot be mapped, such as a pipe. */
+bool parseEpwStream(std::istream &stream, EpwRecordHandler &handler, std::string &message);
+
+/** Parse an EPW file that may be compressed. Uncompressed files are mapped as
+ *  in parseEpwFile, compressed files are decompressed into the parser a block
+ *  at a time. If sourceHash is given, the bytes of the file as stored
+ *  (compressed or not) are added to it during the same pass. */
+bool parseEpwInput(const openstudio::path &path, EpwRecordHandler &handler, std::string &message,
+  ContentHash *sourceHash=nullptr);
+
+#endif // EPWREADER_HPP
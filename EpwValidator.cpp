@@ -0,0 +1,146 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "EpwValidator.hpp"
+#include "StreamIO.hpp"
+
+#include <boost/lexical_cast.hpp>
+
+#include <fstream>
+
+EpwValidator::EpwValidator() : m_startDayOfYear(1), m_expected(0), m_records(0)
+{
+}
+
+bool EpwValidator::header(const EpwHeader &header, std::string &message)
+{
+  m_header = header;
+  m_startDayOfYear = header.startDayOfYear();
+  m_expected = (unsigned long)header.numberOfDays()*24*header.recordsPerHour;
+  m_records = 0;
+  return true;
+}
+
+bool EpwValidator::record(const EpwRecord &record, std::string &message)
+{
+  ++m_records;
+  if(m_records > m_expected) {
+    message = "More data records than the " + boost::lexical_cast<std::string>(m_expected)
+      + " in the data period";
+    return false;
+  }
+
+  // Work out where this record should be from its position in the file
+  unsigned long index = m_records - 1;
+  unsigned long perDay = 24*m_header.recordsPerHour;
+  int month, day;
+  epwMonthDay(m_startDayOfYear + (int)(index/perDay), month, day, m_header.leapYear);
+  int hour = (int)((index%perDay)/m_header.recordsPerHour) + 1;
+
+  if(record.month() != month || record.day() != day || record.hour() != hour) {
+    message = "Data record " + boost::lexical_cast<std::string>(m_records) + " is for "
+      + boost::lexical_cast<std::string>(record.month()) + "/" + boost::lexical_cast<std::string>(record.day())
+      + " hour " + boost::lexical_cast<std::string>(record.hour()) + ", expected "
+      + boost::lexical_cast<std::string>(month) + "/" + boost::lexical_cast<std::string>(day)
+      + " hour " + boost::lexical_cast<std::string>(hour);
+    return false;
+  }
+  if(record.minute() < 0 || record.minute() > 60) {
+    message = "Data record " + boost::lexical_cast<std::string>(m_records) + " has invalid minute "
+      + boost::lexical_cast<std::string>(record.minute());
+    return false;
+  }
+  return true;
+}
+
+bool EpwValidator::finish(std::string &message)
+{
+  if(m_records < m_expected) {
+    message = "Expected " + boost::lexical_cast<std::string>(m_expected) + " data records, found "
+      + boost::lexical_cast<std::string>(m_records);
+    return false;
+  }
+  return true;
+}
+
+unsigned long EpwValidator::records() const
+{
+  return m_records;
+}
+
+/** Every record has at least a comma between each field and a newline. */
+static bool checkDataSize(const EpwHeader &header, std::streamoff dataSize, std::string &message)
+{
+  unsigned long expected = (unsigned long)header.numberOfDays()*24*header.recordsPerHour;
+  if(dataSize < (std::streamoff)expected*EPW_MIN_FIELDS) {
+    message = "File is too short to hold the " + boost::lexical_cast<std::string>(expected)
+      + " data records in the data period";
+    return false;
+  }
+  return true;
+}
+
+bool triageEpwFile(const openstudio::path &path, std::string &message)
+{
+  EpwHeader header;
+  if(isCompressedPath(path)) {
+    InputFile input;
+    if(!input.open(path, message)) {
+      return false;
+    }
+    if(!header.read(input.stream(), message)) {
+      if(!input.error().empty()) {
+        message = input.error();
+      }
+      return false;
+    }
+    return true;
+  }
+
+  std::ifstream file(openstudio::toString(path).c_str(), std::ios_base::in | std::ios_base::binary);
+  if(!file) {
+    message = "Failed to open '" + openstudio::toString(path) + "'";
+    return false;
+  }
+  if(!header.read(file, message)) {
+    return false;
+  }
+  std::streamoff dataStart = file.tellg();
+  file.seekg(0, std::ios_base::end);
+  std::streamoff size = file.tellg();
+
+  // The records themselves are left to the full check. A file whose last
+  // record is not the final hour of the data period may still be readable,
+  // so that is no reason to reject it here.
+  return checkDataSize(header, size - dataStart, message);
+}
+
+bool triageEpwStream(std::istream &stream, boost::uint64_t size, std::string &message)
+{
+  EpwHeader header;
+  if(!header.read(stream, message)) {
+    return false;
+  }
+  // Streams that cannot tell where they are only get the header checked
+  std::streamoff dataStart = stream.tellg();
+  if(dataStart < 0) {
+    return true;
+  }
+  return checkDataSize(header, (std::streamoff)size - dataStart, message);
+}
@@ -0,0 +1,64 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef EPWVALIDATOR_HPP
+#define EPWVALIDATOR_HPP
+
+#include "EpwReader.hpp"
+
+#include <boost/cstdint.hpp>
+
+/** EpwValidator checks the structure of the data in an EPW file: that every
+ *  record is in the period given in the header, that the records follow one
+ *  another without gaps or repeats at the stated number of records per hour,
+ *  and that the period is complete. Warnings about individual values (for
+ *  example missing value codes) are not produced, use EpwFile for those. */
+class EpwValidator : public EpwRecordHandler
+{
+public:
+  EpwValidator();
+
+  virtual bool header(const EpwHeader &header, std::string &message);
+  virtual bool record(const EpwRecord &record, std::string &message);
+  virtual bool finish(std::string &message);
+
+  /** Number of records checked. */
+  unsigned long records() const;
+
+private:
+  EpwHeader m_header;
+  int m_startDayOfYear;
+  unsigned long m_expected;
+  unsigned long m_records;
+};
+
+/** Check an EPW file without reading its data records: the header must parse
+ *  and the file must be long enough to hold the records the data period calls
+ *  for. Only the header is read, so this runs at close to the speed of opening
+ *  the file. Compressed files only have their header checked, their size says
+ *  little about the records in them. */
+bool triageEpwFile(const openstudio::path &path, std::string &message);
+
+/** Check the header of an EPW stream, such as a member of an archive, and
+ *  that its size, given separately, can hold the records the data period
+ *  calls for. The end of the data is not checked, getting to it would mean
+ *  reading everything before it. */
+bool triageEpwStream(std::istream &stream, boost::uint64_t size, std::string &message);
+
+#endif // EPWVALIDATOR_HPP
@@ -0,0 +1,172 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "InputList.hpp"
+#include "StreamIO.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/regex.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+static bool hasExtension(const openstudio::path &path, const std::string &extension)
+{
+  return boost::algorithm::iequals(path.extension().string(), extension);
+}
+
+static boost::regex wildcardRegex(const std::string &pattern)
+{
+  std::string expression;
+  for(char c : pattern) {
+    switch(c) {
+    case '*':
+      expression += ".*";
+      break;
+    case '?':
+      expression += '.';
+      break;
+    case '.': case '[': case ']': case '(': case ')': case '{': case '}':
+    case '+': case '^': case '$': case '|': case '\\':
+      expression += '\\';
+      expression += c;
+      break;
+    default:
+      expression += c;
+    }
+  }
+  return boost::regex(expression);
+}
+
+static bool listDirectory(const openstudio::path &dir, const std::string &extension, const boost::regex *pattern,
+  std::vector<openstudio::path> &paths)
+{
+  std::vector<openstudio::path> found;
+  boost::system::error_code ec;
+  for(boost::filesystem::directory_iterator it(dir,ec), end; !ec && it != end; it.increment(ec)) {
+    if(!boost::filesystem::is_regular_file(it->status())) {
+      continue;
+    }
+    openstudio::path path = it->path();
+    if(pattern) {
+      if(!boost::regex_match(path.filename().string(), *pattern)) {
+        continue;
+      }
+    } else if(!hasExtension(stripCompressionExtension(path), extension)) {
+      continue;
+    }
+    found.push_back(path);
+  }
+  if(ec) {
+    return false;
+  }
+  std::sort(found.begin(), found.end());
+  paths.insert(paths.end(), found.begin(), found.end());
+  return true;
+}
+
+bool expandInputs(const std::vector<std::string> &args, const std::string &extension,
+  std::vector<openstudio::path> &paths, std::string &message)
+{
+  for(const std::string &arg : args) {
+    if(arg.size() > 1 && arg[0] == '@') {
+      std::ifstream list(arg.substr(1).c_str());
+      if(!list) {
+        message = "Failed to open list file '" + arg.substr(1) + "'";
+        return false;
+      }
+      std::string line;
+      while(std::getline(list, line)) {
+        boost::algorithm::trim(line);
+        if(!line.empty()) {
+          paths.push_back(openstudio::toPath(line));
+        }
+      }
+      continue;
+    }
+
+    openstudio::path path = openstudio::toPath(arg);
+    if(arg.find_first_of("*?") != std::string::npos) {
+      openstudio::path dir = path.parent_path();
+      if(dir.empty()) {
+        dir = openstudio::toPath(".");
+      }
+      if(dir.string().find_first_of("*?") != std::string::npos) {
+        message = "Wildcards are only supported in the file name of '" + arg + "'";
+        return false;
+      }
+      boost::regex pattern = wildcardRegex(path.filename().string());
+      if(!listDirectory(dir, extension, &pattern, paths)) {
+        message = "Failed to list directory '" + dir.string() + "'";
+        return false;
+      }
+    } else if(boost::filesystem::is_directory(path)) {
+      if(!listDirectory(path, extension, nullptr, paths)) {
+        message = "Failed to list directory '" + arg + "'";
+        return false;
+      }
+    } else {
+      paths.push_back(path);
+    }
+  }
+  return true;
+}
+
+bool walkDirectory(const openstudio::path &root, const std::vector<std::string> &extensions,
+  const std::function<bool(const openstudio::path &path)> &found, std::string &message)
+{
+  bool success = true;
+  std::vector<openstudio::path> pending(1, root);
+  while(!pending.empty()) {
+    openstudio::path dir = pending.back();
+    pending.pop_back();
+    std::vector<openstudio::path> files;
+    std::vector<openstudio::path> subdirs;
+    boost::system::error_code ec;
+    for(boost::filesystem::directory_iterator it(dir,ec), end; !ec && it != end; it.increment(ec)) {
+      boost::filesystem::file_status status = it->symlink_status();
+      if(boost::filesystem::is_directory(status)) {
+        subdirs.push_back(it->path());
+      } else if(boost::filesystem::is_regular_file(it->status())) {
+        openstudio::path stripped = stripCompressionExtension(it->path());
+        for(const std::string &extension : extensions) {
+          if(hasExtension(stripped, extension)) {
+            files.push_back(it->path());
+            break;
+          }
+        }
+      }
+    }
+    if(ec && success) {
+      message = "Failed to list directory '" + dir.string() + "': " + ec.message();
+      success = false;
+    }
+    std::sort(files.begin(), files.end());
+    for(const openstudio::path &file : files) {
+      if(!found(file)) {
+        return success;
+      }
+    }
+    // Pushed in reverse so that they come off the stack in sorted order
+    std::sort(subdirs.begin(), subdirs.end());
+    pending.insert(pending.end(), subdirs.rbegin(), subdirs.rend());
+  }
+  return success;
+}
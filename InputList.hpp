@@ -0,0 +1,54 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef INPUTLIST_HPP
+#define INPUTLIST_HPP
+
+#include <utilities/core/Path.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/** Expand command line input arguments into a list of files, in argument
+ *  order. Each argument may be
+ *    - a file path, used as is,
+ *    - @listfile, a text file with one path per line (blank lines are skipped),
+ *    - a directory, which contributes every file in it with the given extension,
+ *      compressed (.gz or .zst) or not,
+ *    - a path with wildcards (* and ?) in its file name, matched against the
+ *      files in the named directory.
+ *  Directory and wildcard matches are sorted so that the result does not
+ *  depend on the file system. Returns false and sets message if an argument
+ *  cannot be expanded. */
+bool expandInputs(const std::vector<std::string> &args, const std::string &extension,
+  std::vector<openstudio::path> &paths, std::string &message);
+
+/** Walk the directory tree under root and call found for every file in it
+ *  with one of the given extensions, compressed or not, as soon as it is seen
+ *  rather than once the whole tree has been listed. The files in a directory are
+ *  given in sorted order before its subdirectories are walked, also in sorted
+ *  order, and symbolic links to directories are not followed. The walk stops
+ *  early if found returns false. A directory that cannot be read is skipped,
+ *  the walk carries on and returns false with message naming the first such
+ *  directory. */
+bool walkDirectory(const openstudio::path &root, const std::vector<std::string> &extensions,
+  const std::function<bool(const openstudio::path &path)> &found, std::string &message);
+
+#endif // INPUTLIST_HPP
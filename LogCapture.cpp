@@ -0,0 +1,97 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#include "LogCapture.hpp"
+
+#include <utilities/core/Logger.hpp>
+
+#include <QThread>
+
+#include <boost/regex.hpp>
+
+#include <memory>
+
+// The sink for this thread, it lives until the thread exits
+static thread_local std::unique_ptr<openstudio::StringStreamLogSink> threadSink;
+static thread_local std::string threadChannels;
+
+static openstudio::StringStreamLogSink &sinkForThread(const std::string &channelRegex)
+{
+  if(!threadSink) {
+    threadSink.reset(new openstudio::StringStreamLogSink);
+    threadSink->setThreadId(QThread::currentThread());
+    threadChannels.clear();
+  }
+  if(channelRegex != threadChannels) {
+    threadSink->setChannelRegex(boost::regex(channelRegex));
+    threadChannels = channelRegex;
+  }
+  return *threadSink;
+}
+
+LogCapture::LogCapture(const std::string &channelRegex, std::size_t limit) : m_limit(limit ? limit : 1), m_next(0),
+  m_dropped(0)
+{
+  // Whatever an earlier capture left behind does not belong to this one
+  sinkForThread(channelRegex).resetStringStream();
+  m_ring.reserve(m_limit);
+}
+
+LogCapture::~LogCapture()
+{
+  if(threadSink) {
+    threadSink->resetStringStream();
+  }
+}
+
+void LogCapture::collect()
+{
+  if(!threadSink) {
+    return;
+  }
+  for(const openstudio::LogMessage &mesg : threadSink->logMessages()) {
+    if(m_ring.size() < m_limit) {
+      m_ring.push_back(mesg.logMessage());
+    } else {
+      m_ring[m_next] = mesg.logMessage();
+      m_next = (m_next + 1) % m_limit;
+      ++m_dropped;
+    }
+  }
+  threadSink->resetStringStream();
+}
+
+std::vector<std::string> LogCapture::messages()
+{
+  collect();
+  std::vector<std::string> messages;
+  messages.reserve(m_ring.size());
+  for(std::size_t i=0;i<m_ring.size();i++) {
+    messages.push_back(m_ring[(m_next + i) % m_ring.size()]);
+  }
+  m_ring.clear();
+  m_next = 0;
+  return messages;
+}
+
+std::size_t LogCapture::dropped() const
+{
+  return m_dropped;
+}
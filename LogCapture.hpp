@@ -0,0 +1,66 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#ifndef LOGCAPTURE_HPP
+#define LOGCAPTURE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/** LogCapture collects the OpenStudio log messages that the current thread
+ *  writes to matching channels while the capture is in scope, so that a task
+ *  running on a WorkerPool sees only its own messages no matter how many other
+ *  tasks are logging at the same time. Each thread that captures gets one log
+ *  sink, restricted to that thread and created the first time it is needed,
+ *  so a capture costs a reset and a drain rather than registering a new sink
+ *  with the logger. The sink holds every message logged until they are
+ *  collected, which only happens when messages is called, so a capture does
+ *  not bound the memory a long call that logs heavily uses. Collecting keeps
+ *  the most recent limit messages in a ring and empties the sink, so only
+ *  the number of messages handed back is bounded. Captures on one thread
+ *  must not overlap. */
+class LogCapture
+{
+public:
+  /** Start capturing messages from channels matching channelRegex, keeping at
+   *  most limit of them. */
+  explicit LogCapture(const std::string &channelRegex, std::size_t limit=64);
+  /** Stop capturing, anything not collected with messages is discarded. */
+  ~LogCapture();
+
+  /** Collect the messages logged so far, oldest first, and clear them. */
+  std::vector<std::string> messages();
+  /** Number of messages that did not fit in the ring. */
+  std::size_t dropped() const;
+
+private:
+  LogCapture(const LogCapture&);
+  LogCapture& operator=(const LogCapture&);
+
+  void collect();
+
+  std::vector<std::string> m_ring;
+  std::size_t m_limit;
+  std::size_t m_next;
+  std::size_t m_dropped;
+};
+
+#endif // LOGCAPTURE_HPP
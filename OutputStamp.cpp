@@ -0,0 +1,111 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "OutputStamp.hpp"
+#include "ContentHash.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <sstream>
+
+OutputStamp::OutputStamp() : inputHash(0), inputSize(0), outputSize(0)
+{
+}
+
+bool OutputStamp::hashInput(const openstudio::path &inputPath, std::string &message)
+{
+  return hashFile(inputPath, inputHash, inputSize, message);
+}
+
+bool OutputStamp::read(const openstudio::path &outputPath)
+{
+  std::ifstream file(stampPath(outputPath).string().c_str());
+  if(!file) {
+    return false;
+  }
+  bool haveVersion = false, haveOptions = false, haveInput = false, haveOutput = false;
+  std::string line;
+  while(std::getline(file, line)) {
+    std::string::size_type equals = line.find('=');
+    if(equals == std::string::npos) {
+      continue;
+    }
+    std::string key = line.substr(0, equals);
+    std::string value = line.substr(equals+1);
+    if(key == "version") {
+      version = value;
+      haveVersion = true;
+    } else if(key == "options") {
+      options = value;
+      haveOptions = true;
+    } else if(key == "input") {
+      std::istringstream stream(value);
+      haveInput = static_cast<bool>(stream >> std::hex >> inputHash >> std::dec >> inputSize);
+    } else if(key == "output") {
+      std::istringstream stream(value);
+      haveOutput = static_cast<bool>(stream >> outputSize);
+    }
+  }
+  return haveVersion && haveOptions && haveInput && haveOutput;
+}
+
+bool OutputStamp::write(const openstudio::path &outputPath, std::string &message)
+{
+  boost::system::error_code ec;
+  outputSize = boost::filesystem::file_size(outputPath, ec);
+  if(ec) {
+    message = "Could not determine the size of '" + openstudio::toString(outputPath) + "'";
+    return false;
+  }
+  openstudio::path path = stampPath(outputPath);
+  std::ofstream file(path.string().c_str(), std::ios_base::out | std::ios_base::trunc);
+  file << "version=" << version << "\n";
+  file << "options=" << options << "\n";
+  file << "input=" << ContentHash::toHex(inputHash) << " " << inputSize << "\n";
+  file << "output=" << outputSize << "\n";
+  file.close();
+  if(!file) {
+    message = "Failed to write stamp file '" + openstudio::toString(path) + "'";
+    return false;
+  }
+  return true;
+}
+
+bool OutputStamp::upToDate(const openstudio::path &outputPath) const
+{
+  OutputStamp stored;
+  if(!stored.read(outputPath)) {
+    return false;
+  }
+  if(stored.version != version || stored.options != options || stored.inputHash != inputHash
+    || stored.inputSize != inputSize) {
+    return false;
+  }
+  boost::system::error_code ec;
+  boost::uint64_t size = boost::filesystem::file_size(outputPath, ec);
+  return !ec && size == stored.outputSize;
+}
+
+openstudio::path stampPath(const openstudio::path &outputPath)
+{
+  openstudio::path path = outputPath;
+  path += openstudio::toPath(".stamp");
+  return path;
+}
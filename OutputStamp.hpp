@@ -0,0 +1,63 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef OUTPUTSTAMP_HPP
+#define OUTPUTSTAMP_HPP
+
+#include <utilities/core/Path.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <string>
+
+/** OutputStamp records what a generated file was made from: the content hash
+ *  and size of the input, the version of the program that made it and the
+ *  options that affect its content, along with the size of the output. The
+ *  stamp is kept in a small text file next to the output (output path plus
+ *  ".stamp"), and the output only needs to be regenerated when a freshly
+ *  computed stamp differs from the stored one or the output has changed
+ *  size. */
+struct OutputStamp
+{
+  OutputStamp();
+
+  /** Fill in the input hash and size by hashing the input file. */
+  bool hashInput(const openstudio::path &inputPath, std::string &message);
+
+  /** Read the stamp stored for an output, returns false if there is none or
+   *  it cannot be read. */
+  bool read(const openstudio::path &outputPath);
+  /** Record the stamp for an output, the output size is taken from the file. */
+  bool write(const openstudio::path &outputPath, std::string &message);
+
+  /** True if the stored stamp for outputPath matches this one and the output
+   *  is still the size it was when the stamp was written. */
+  bool upToDate(const openstudio::path &outputPath) const;
+
+  std::string version;
+  std::string options;
+  boost::uint64_t inputHash;
+  boost::uint64_t inputSize;
+  boost::uint64_t outputSize;
+};
+
+/** Path of the stamp file for an output file. */
+openstudio::path stampPath(const openstudio::path &outputPath);
+
+#endif // OUTPUTSTAMP_HPP
@@ -0,0 +1,366 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#include "ProcessPool.hpp"
+#include "WorkerPool.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+ProcessPool::ProcessPool(unsigned nProcesses, Job job, double timeout) : m_workers(nProcesses ? nProcesses
+  : WorkerPool::hardwareThreads()), m_job(job), m_timeout(timeout), m_replaced(0)
+{
+}
+
+unsigned ProcessPool::size() const
+{
+  return (unsigned)m_workers.size();
+}
+
+unsigned ProcessPool::replaced() const
+{
+  return m_replaced;
+}
+
+#ifdef _WIN32
+
+ProcessPool::~ProcessPool()
+{
+}
+
+bool ProcessPool::supported()
+{
+  return false;
+}
+
+bool ProcessPool::start(std::string &message)
+{
+  message = "Worker processes are not supported on Windows";
+  return false;
+}
+
+void ProcessPool::run(const std::vector<std::string> &requests, Done done)
+{
+  for(std::size_t i=0;i<requests.size();i++) {
+    done(i, Crashed, "no worker processes");
+  }
+}
+
+#else
+
+static double now()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Messages on the pipes are a 32 bit length followed by that many bytes
+static bool writeAll(int fd, const char *data, std::size_t size)
+{
+  while(size) {
+    ssize_t n = write(fd, data, size);
+    if(n < 0 && errno == EINTR) {
+      continue;
+    }
+    if(n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+// With a deadline (greater than zero), each chunk is waited for with poll so
+// that a worker that stops part way through a message cannot block past it.
+// Data already waiting is still read once the deadline has passed.
+static bool readAll(int fd, char *data, std::size_t size, double deadline, bool *timedOut)
+{
+  while(size) {
+    if(deadline > 0) {
+      pollfd fds = {fd, POLLIN, 0};
+      int ready = poll(&fds, 1, std::max(0, (int)((deadline - now())*1000.0) + 1));
+      if(ready < 0 && errno == EINTR) {
+        continue;
+      }
+      if(ready == 0 && timedOut) {
+        *timedOut = true;
+      }
+      if(ready <= 0) {
+        return false;
+      }
+    }
+    ssize_t n = read(fd, data, size);
+    if(n < 0 && errno == EINTR) {
+      continue;
+    }
+    if(n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool writeMessage(int fd, const std::string &message)
+{
+  boost::uint32_t length = (boost::uint32_t)message.size();
+  return writeAll(fd, (const char*)&length, sizeof(length)) && writeAll(fd, message.data(), message.size());
+}
+
+static bool readMessage(int fd, std::string &message, double deadline=0, bool *timedOut=nullptr)
+{
+  boost::uint32_t length;
+  if(!readAll(fd, (char*)&length, sizeof(length), deadline, timedOut)) {
+    return false;
+  }
+  message.resize(length);
+  return !length || readAll(fd, &message[0], length, deadline, timedOut);
+}
+
+ProcessPool::~ProcessPool()
+{
+  // Idle workers exit when their request pipe closes
+  for(Worker &worker : m_workers) {
+    reap(worker, worker.busy);
+  }
+}
+
+bool ProcessPool::supported()
+{
+  return true;
+}
+
+bool ProcessPool::start(std::string &message)
+{
+  // A worker dying between jobs shows up as a failed write, not a signal
+  std::signal(SIGPIPE, SIG_IGN);
+  for(Worker &worker : m_workers) {
+    if(worker.pid < 0 && !spawn(worker, message)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ProcessPool::spawn(Worker &worker, std::string &message)
+{
+  int requestPipe[2];
+  int replyPipe[2];
+  if(pipe(requestPipe)) {
+    message = std::string("Failed to create a pipe: ") + std::strerror(errno);
+    return false;
+  }
+  if(pipe(replyPipe)) {
+    message = std::string("Failed to create a pipe: ") + std::strerror(errno);
+    close(requestPipe[0]);
+    close(requestPipe[1]);
+    return false;
+  }
+  // Anything still buffered would otherwise be written again by the child
+  std::cout.flush();
+  std::fflush(nullptr);
+  pid_t pid = fork();
+  if(pid < 0) {
+    message = std::string("Failed to start a worker process: ") + std::strerror(errno);
+    close(requestPipe[0]);
+    close(requestPipe[1]);
+    close(replyPipe[0]);
+    close(replyPipe[1]);
+    return false;
+  }
+  if(!pid) {
+    // The other workers' pipes have to be closed here, or they would not see
+    // the end of their requests when this process outlives the pool
+    for(const Worker &other : m_workers) {
+      if(other.pid >= 0) {
+        close(other.requestFd);
+        close(other.replyFd);
+      }
+    }
+    close(requestPipe[1]);
+    close(replyPipe[0]);
+    serve(requestPipe[0], replyPipe[1]);
+    _exit(0);
+  }
+  close(requestPipe[0]);
+  close(replyPipe[1]);
+  worker.pid = pid;
+  worker.requestFd = requestPipe[1];
+  worker.replyFd = replyPipe[0];
+  worker.busy = false;
+  return true;
+}
+
+void ProcessPool::serve(int requestFd, int replyFd)
+{
+  std::string request;
+  while(readMessage(requestFd, request)) {
+    std::string reply;
+    try {
+      reply = m_job(request);
+    } catch(...) {
+      // An escaped exception is a crash as far as the caller is concerned
+      _exit(2);
+    }
+    if(!writeMessage(replyFd, reply)) {
+      break;
+    }
+  }
+}
+
+int ProcessPool::reap(Worker &worker, bool kill)
+{
+  int status = 0;
+  if(worker.pid < 0) {
+    return status;
+  }
+  if(kill) {
+    ::kill(worker.pid, SIGKILL);
+  }
+  close(worker.requestFd);
+  close(worker.replyFd);
+  while(waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  worker.pid = -1;
+  worker.busy = false;
+  return status;
+}
+
+static std::string describeExit(int status)
+{
+  if(WIFSIGNALED(status)) {
+    int signal = WTERMSIG(status);
+    const char *name = strsignal(signal);
+    return "killed by signal " + boost::lexical_cast<std::string>(signal) + (name ? std::string(" (") + name + ")" : "");
+  }
+  if(WIFEXITED(status)) {
+    return "exited with status " + boost::lexical_cast<std::string>(WEXITSTATUS(status));
+  }
+  return "stopped";
+}
+
+void ProcessPool::run(const std::vector<std::string> &requests, Done done)
+{
+  std::size_t next = 0;
+  std::size_t finished = 0;
+  std::vector<pollfd> fds;
+  std::vector<Worker*> polled;
+  while(finished < requests.size()) {
+    // Hand out work to every idle worker, replacing any that died while idle
+    for(Worker &worker : m_workers) {
+      while(!worker.busy && next < requests.size()) {
+        std::string message;
+        if(worker.pid < 0 && !spawn(worker, message)) {
+          done(next++, Crashed, message);
+          ++finished;
+          continue;
+        }
+        if(!writeMessage(worker.requestFd, requests[next])) {
+          reap(worker, true);
+          ++m_replaced;
+          continue;
+        }
+        worker.busy = true;
+        worker.index = next++;
+        worker.deadline = m_timeout > 0 ? now() + m_timeout : 0;
+      }
+    }
+
+    fds.clear();
+    polled.clear();
+    double wake = 0;
+    for(Worker &worker : m_workers) {
+      if(worker.busy) {
+        pollfd fd = {worker.replyFd, POLLIN, 0};
+        fds.push_back(fd);
+        polled.push_back(&worker);
+        if(worker.deadline > 0 && (wake <= 0 || worker.deadline < wake)) {
+          wake = worker.deadline;
+        }
+      }
+    }
+    if(fds.empty()) {
+      continue;
+    }
+    int timeout = -1;
+    if(wake > 0) {
+      timeout = std::max(0, (int)((wake - now())*1000.0) + 1);
+    }
+    int ready = poll(&fds[0], fds.size(), timeout);
+    if(ready < 0 && errno != EINTR) {
+      // Nothing sensible can be done without poll, give up on the running jobs
+      for(Worker *worker : polled) {
+        std::size_t index = worker->index;
+        reap(*worker, true);
+        ++m_replaced;
+        done(index, Crashed, std::string("poll failed: ") + std::strerror(errno));
+        ++finished;
+      }
+      continue;
+    }
+
+    double time = now();
+    for(std::size_t i=0;i<fds.size();i++) {
+      Worker &worker = *polled[i];
+      std::size_t index = worker.index;
+      if(fds[i].revents) {
+        std::string reply;
+        bool timedOut = false;
+        if(readMessage(worker.replyFd, reply, worker.deadline, &timedOut)) {
+          worker.busy = false;
+          done(index, Completed, reply);
+        } else if(timedOut) {
+          // The reply started but did not finish in time
+          reap(worker, true);
+          ++m_replaced;
+          done(index, TimedOut, "no verdict after " + boost::lexical_cast<std::string>(m_timeout) + " s");
+        } else {
+          // The worker is gone, its exit status says how it died
+          int status = reap(worker, false);
+          ++m_replaced;
+          done(index, Crashed, describeExit(status));
+        }
+        ++finished;
+      } else if(worker.deadline > 0 && time >= worker.deadline) {
+        reap(worker, true);
+        ++m_replaced;
+        done(index, TimedOut, "no verdict after " + boost::lexical_cast<std::string>(m_timeout) + " s");
+        ++finished;
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,95 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#ifndef PROCESSPOOL_HPP
+#define PROCESSPOOL_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/** ProcessPool runs jobs in a set of worker processes so that a job that
+ *  crashes or hangs takes only its own worker down. The workers are forked
+ *  from this process once, when the pool is started, and each one then runs
+ *  job after job, so there is no fork, exec or library load per job. A job
+ *  takes a request string and returns a reply string, both are passed over
+ *  pipes. A worker that dies or runs past the timeout is replaced with a new
+ *  fork and its job is reported as crashed or timed out. Workers share the
+ *  state of this process as it was at the fork, so the pool must be started
+ *  before any other thread is, forking a multithreaded process leaves locks
+ *  held by the other threads locked forever in the child. Worker processes
+ *  are only available on POSIX systems. */
+class ProcessPool
+{
+public:
+  typedef std::function<std::string(const std::string &request)> Job;
+
+  enum Outcome { Completed, Crashed, TimedOut };
+  /** Called in this process as each job finishes, reply holds the reply of a
+   *  completed job and a description of what happened otherwise. */
+  typedef std::function<void(std::size_t index, Outcome outcome, const std::string &reply)> Done;
+
+  /** A pool of nProcesses workers running job, zero means one per hardware
+   *  thread. A job that runs for more than timeout seconds is killed, zero
+   *  means jobs may run for as long as they like. */
+  ProcessPool(unsigned nProcesses, Job job, double timeout=0);
+  /** Stop the workers and wait for them to exit. */
+  ~ProcessPool();
+
+  /** Fork the workers. */
+  bool start(std::string &message);
+  /** Run the job on every request, returning once they have all finished. */
+  void run(const std::vector<std::string> &requests, Done done);
+  /** Number of workers. */
+  unsigned size() const;
+  /** Number of workers that have been replaced after a crash or timeout. */
+  unsigned replaced() const;
+
+  /** True if worker processes are available on this system. */
+  static bool supported();
+
+private:
+  ProcessPool(const ProcessPool&);
+  ProcessPool& operator=(const ProcessPool&);
+
+  struct Worker
+  {
+    Worker() : pid(-1), requestFd(-1), replyFd(-1), busy(false), index(0)
+    {}
+    int pid;
+    int requestFd;
+    int replyFd;
+    bool busy;
+    std::size_t index;
+    double deadline;
+  };
+
+  bool spawn(Worker &worker, std::string &message);
+  void serve(int requestFd, int replyFd);
+  int reap(Worker &worker, bool kill);
+
+  std::vector<Worker> m_workers;
+  Job m_job;
+  double m_timeout;
+  unsigned m_replaced;
+};
+
+#endif // PROCESSPOOL_HPP
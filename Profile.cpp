@@ -0,0 +1,198 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#include "Profile.hpp"
+
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+double threadCpuSeconds()
+{
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  if(!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+    return 0.0;
+  }
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime;
+  k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;
+  u.HighPart = user.dwHighDateTime;
+  return (k.QuadPart + u.QuadPart)*1.0e-7;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+  struct timespec ts;
+  if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0.0;
+  }
+  return ts.tv_sec + ts.tv_nsec*1.0e-9;
+#else
+  return (double)std::clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+std::string jsonEscape(const std::string &string)
+{
+  std::string result;
+  for(char c : string) {
+    switch(c) {
+    case '"':
+      result += "\\\"";
+      break;
+    case '\\':
+      result += "\\\\";
+      break;
+    case '\n':
+      result += "\\n";
+      break;
+    case '\r':
+      result += "\\r";
+      break;
+    case '\t':
+      result += "\\t";
+      break;
+    default:
+      if((unsigned char)c < 0x20) {
+        char buffer[8];
+        std::snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned)c);
+        result += buffer;
+      } else {
+        result += c;
+      }
+    }
+  }
+  return result;
+}
+
+Profile::Profile() : bytesRead(0), bytesWritten(0), rows(0), m_running(false), m_cpuStart(0.0)
+{
+}
+
+void Profile::begin(const std::string &phase)
+{
+  end();
+  Phase current = {phase, 0.0, 0.0};
+  m_phases.push_back(current);
+  m_running = true;
+  m_cpuStart = threadCpuSeconds();
+  m_wallStart = std::chrono::steady_clock::now();
+}
+
+void Profile::end()
+{
+  if(!m_running) {
+    return;
+  }
+  m_phases.back().wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_wallStart).count();
+  m_phases.back().cpu = threadCpuSeconds() - m_cpuStart;
+  m_running = false;
+}
+
+void Profile::addDetail(const std::string &name, double seconds)
+{
+  m_details.push_back(std::make_pair(name, seconds));
+}
+
+const std::vector<Profile::Phase> &Profile::phases() const
+{
+  return m_phases;
+}
+
+const std::vector<std::pair<std::string, double> > &Profile::details() const
+{
+  return m_details;
+}
+
+void Profile::writeText(std::ostream &stream) const
+{
+  std::ios_base::fmtflags flags = stream.flags();
+  std::streamsize precision = stream.precision();
+  stream << std::fixed << std::setprecision(3);
+  stream << "  " << std::left << std::setw(24) << "phase" << std::right << std::setw(12) << "wall (ms)"
+    << std::setw(12) << "cpu (ms)" << "\n";
+  double wall = 0.0, cpu = 0.0;
+  for(const Phase &phase : m_phases) {
+    stream << "  " << std::left << std::setw(24) << phase.name << std::right << std::setw(12) << 1000.0*phase.wall
+      << std::setw(12) << 1000.0*phase.cpu << "\n";
+    wall += phase.wall;
+    cpu += phase.cpu;
+  }
+  stream << "  " << std::left << std::setw(24) << "total" << std::right << std::setw(12) << 1000.0*wall
+    << std::setw(12) << 1000.0*cpu << "\n";
+  for(const std::pair<std::string, double> &detail : m_details) {
+    stream << "  " << std::left << std::setw(24) << detail.first << std::right << std::setw(12) << 1000.0*detail.second
+      << "\n";
+  }
+  stream << "  rows " << rows << ", bytes read " << bytesRead << ", bytes written " << bytesWritten << "\n";
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+void Profile::writeJson(std::ostream &stream) const
+{
+  std::streamsize precision = stream.precision();
+  stream << std::setprecision(9);
+  stream << "{\"phases\":[";
+  for(std::size_t i=0;i<m_phases.size();i++) {
+    stream << (i ? "," : "") << "{\"name\":\"" << jsonEscape(m_phases[i].name) << "\",\"wall_seconds\":"
+      << m_phases[i].wall << ",\"cpu_seconds\":" << m_phases[i].cpu << "}";
+  }
+  stream << "],\"details\":{";
+  for(std::size_t i=0;i<m_details.size();i++) {
+    stream << (i ? "," : "") << "\"" << jsonEscape(m_details[i].first) << "\":" << m_details[i].second;
+  }
+  stream << "},\"rows\":" << rows << ",\"bytes_read\":" << bytesRead << ",\"bytes_written\":" << bytesWritten << "}";
+  stream.precision(precision);
+}
+
+ProfiledHandler::ProfiledHandler(EpwRecordHandler &handler, Profile &profile, const std::string &handlerName)
+  : m_handler(handler), m_profile(profile), m_name(handlerName), m_handlerTime(0)
+{
+}
+
+bool ProfiledHandler::header(const EpwHeader &header, std::string &message)
+{
+  bool ok = m_handler.header(header, message);
+  m_profile.begin("records");
+  return ok;
+}
+
+bool ProfiledHandler::record(const EpwRecord &record, std::string &message)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool ok = m_handler.record(record, message);
+  m_handlerTime += std::chrono::steady_clock::now() - start;
+  ++m_profile.rows;
+  return ok;
+}
+
+bool ProfiledHandler::finish(std::string &message)
+{
+  m_profile.begin("finish");
+  bool ok = m_handler.finish(message);
+  m_profile.addDetail("records in " + m_name, std::chrono::duration<double>(m_handlerTime).count());
+  return ok;
+}
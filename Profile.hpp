@@ -0,0 +1,124 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include "EpwReader.hpp"
+#include "ResourceUsage.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** Profile records where the time goes in one conversion: the wall clock and
+ *  CPU time of each phase, in the order the phases ran, along with counts of
+ *  bytes read and written and rows processed. CPU time is for the calling
+ *  thread, so conversions running side by side on a pool do not count each
+ *  other's work. A profile belongs to one conversion and is not thread safe.
+ *
+ *  Code that can be profiled takes a Profile pointer that is null when
+ *  profiling is off, and calls the free functions below, which then do
+ *  nothing but test the pointer. */
+class Profile
+{
+public:
+  Profile();
+
+  /** End the current phase, if any, and start a new one. */
+  void begin(const std::string &phase);
+  /** End the current phase. */
+  void end();
+
+  /** Add wall clock time spent in a part of a phase that was timed
+   *  separately, such as the writer's share of the records phase. */
+  void addDetail(const std::string &name, double seconds);
+
+  boost::uint64_t bytesRead;
+  boost::uint64_t bytesWritten;
+  boost::uint64_t rows;
+
+  struct Phase
+  {
+    std::string name;
+    double wall;
+    double cpu;
+  };
+
+  const std::vector<Phase> &phases() const;
+  const std::vector<std::pair<std::string, double> > &details() const;
+
+  /** Write the profile as indented text lines. */
+  void writeText(std::ostream &stream) const;
+  /** Write the profile as a JSON object. */
+  void writeJson(std::ostream &stream) const;
+
+private:
+  std::vector<Phase> m_phases;
+  std::vector<std::pair<std::string, double> > m_details;
+  bool m_running;
+  std::chrono::steady_clock::time_point m_wallStart;
+  double m_cpuStart;
+};
+
+inline void profileBegin(Profile *profile, const char *phase)
+{
+  if(profile) {
+    profile->begin(phase);
+  }
+}
+
+inline void profileEnd(Profile *profile)
+{
+  if(profile) {
+    profile->end();
+  }
+}
+
+/** ProfiledHandler sits in front of another record handler to count rows
+ *  and to time what the handler does with them. The parse is then what is
+ *  left of the records phase. The header callback is taken as the end of the
+ *  header phase and the start of the records phase. */
+class ProfiledHandler : public EpwRecordHandler
+{
+public:
+  ProfiledHandler(EpwRecordHandler &handler, Profile &profile, const std::string &handlerName);
+
+  virtual bool header(const EpwHeader &header, std::string &message);
+  virtual bool record(const EpwRecord &record, std::string &message);
+  virtual bool finish(std::string &message);
+
+private:
+  EpwRecordHandler &m_handler;
+  Profile &m_profile;
+  std::string m_name;
+  std::chrono::steady_clock::duration m_handlerTime;
+};
+
+/** CPU time used so far by the calling thread, in seconds. */
+double threadCpuSeconds();
+
+/** Escape a string for use in JSON. */
+std::string jsonEscape(const std::string &string);
+
+#endif // PROFILE_HPP
@@ -0,0 +1,147 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#include "RecordFanOut.hpp"
+
+RecordFanOut::Output::Output(EpwRecordHandler &handler, const std::string &name, std::size_t queueLength)
+  : handler(&handler), name(name), queue(queueLength), failed(false)
+{
+}
+
+RecordFanOut::RecordFanOut(std::size_t batchSize, std::size_t queueLength) : m_batchSize(batchSize ? batchSize : 1),
+  m_queueLength(queueLength), m_started(false), m_complete(false)
+{
+}
+
+RecordFanOut::~RecordFanOut()
+{
+  std::string message;
+  stop(message);
+}
+
+void RecordFanOut::add(EpwRecordHandler &handler, const std::string &name)
+{
+  m_outputs.push_back(std::unique_ptr<Output>(new Output(handler, name, m_queueLength)));
+}
+
+void RecordFanOut::run(Output &output)
+{
+  std::string message;
+  bool ok = output.handler->header(m_header, message);
+  std::shared_ptr<const Batch> batch;
+  while(ok && output.queue.pop(batch)) {
+    for(std::size_t i=0;i<batch->records.size() && ok;i++) {
+      EpwRecord record = batch->records[i];
+      record.flags = batch->flags.data() + batch->flagOffsets[i];
+      ok = output.handler->record(record, message);
+    }
+  }
+  if(ok && m_complete) {
+    ok = output.handler->finish(message);
+  }
+  if(!ok) {
+    output.failed = true;
+    output.message = message;
+    // Refuse further batches so that the parse stops
+    output.queue.close();
+  }
+}
+
+bool RecordFanOut::header(const EpwHeader &header, std::string &message)
+{
+  if(m_started) {
+    message = "Header given twice";
+    return false;
+  }
+  m_header = header;
+  m_started = true;
+  for(std::unique_ptr<Output> &output : m_outputs) {
+    Output *current = output.get();
+    current->thread = std::thread([this,current]() { run(*current); });
+  }
+  return true;
+}
+
+bool RecordFanOut::record(const EpwRecord &record, std::string &message)
+{
+  if(!m_batch) {
+    m_batch = std::make_shared<Batch>();
+    m_batch->records.reserve(m_batchSize);
+    m_batch->flagOffsets.reserve(m_batchSize);
+  }
+  m_batch->records.push_back(record);
+  m_batch->records.back().flags = nullptr;
+  m_batch->flagOffsets.push_back(m_batch->flags.size());
+  if(record.flags) {
+    m_batch->flags.append(record.flags, record.flagsLength);
+  }
+  if(m_batch->records.size() >= m_batchSize) {
+    return dispatch(message);
+  }
+  return true;
+}
+
+bool RecordFanOut::dispatch(std::string &message)
+{
+  if(!m_batch) {
+    return true;
+  }
+  std::shared_ptr<const Batch> batch = m_batch;
+  m_batch.reset();
+  for(std::unique_ptr<Output> &output : m_outputs) {
+    if(!output->queue.push(batch)) {
+      stop(message);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RecordFanOut::finish(std::string &message)
+{
+  if(!m_started) {
+    message = "No header was given";
+    return false;
+  }
+  if(!dispatch(message)) {
+    return false;
+  }
+  m_complete = true;
+  return stop(message);
+}
+
+bool RecordFanOut::stop(std::string &message)
+{
+  for(std::unique_ptr<Output> &output : m_outputs) {
+    output->queue.close();
+  }
+  for(std::unique_ptr<Output> &output : m_outputs) {
+    if(output->thread.joinable()) {
+      output->thread.join();
+    }
+  }
+  for(std::unique_ptr<Output> &output : m_outputs) {
+    if(output->failed) {
+      message = output->name + ": " + output->message;
+      return false;
+    }
+  }
+  return true;
+}
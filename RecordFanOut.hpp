@@ -0,0 +1,92 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#ifndef RECORDFANOUT_HPP
+#define RECORDFANOUT_HPP
+
+#include "EpwReader.hpp"
+#include "WorkerPool.hpp"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** RecordFanOut passes one parse to several handlers. Each handler runs on its
+ *  own thread and is fed batches of records through its own bounded queue, so
+ *  an output that is slow to write only holds up the parse (and through it
+ *  the other outputs) once its queue is full. Batches are shared between the
+ *  handlers rather than copied for each. The record flags are copied into the
+ *  batch, so handlers see valid flags as usual. If a handler fails, the parse
+ *  is stopped and its message is reported, prefixed with its name. */
+class RecordFanOut : public EpwRecordHandler
+{
+public:
+  /** Records are sent in batches of batchSize, and each handler may have up
+   *  to queueLength batches waiting. */
+  explicit RecordFanOut(std::size_t batchSize=1024, std::size_t queueLength=16);
+  virtual ~RecordFanOut();
+
+  /** Add a handler, which must outlive the fan-out. */
+  void add(EpwRecordHandler &handler, const std::string &name);
+
+  virtual bool header(const EpwHeader &header, std::string &message);
+  virtual bool record(const EpwRecord &record, std::string &message);
+  virtual bool finish(std::string &message);
+
+private:
+  RecordFanOut(const RecordFanOut&);
+  RecordFanOut& operator=(const RecordFanOut&);
+
+  struct Batch
+  {
+    std::vector<EpwRecord> records;
+    std::vector<std::size_t> flagOffsets;
+    std::string flags;
+  };
+
+  struct Output
+  {
+    EpwRecordHandler *handler;
+    std::string name;
+    BoundedQueue<std::shared_ptr<const Batch> > queue;
+    std::thread thread;
+    bool failed;
+    std::string message;
+
+    Output(EpwRecordHandler &handler, const std::string &name, std::size_t queueLength);
+  };
+
+  void run(Output &output);
+  bool dispatch(std::string &message);
+  bool stop(std::string &message);
+
+  std::size_t m_batchSize;
+  std::size_t m_queueLength;
+  std::vector<std::unique_ptr<Output> > m_outputs;
+  EpwHeader m_header;
+  std::shared_ptr<Batch> m_batch;
+  bool m_started;
+  // Set before the queues are closed at the end of a complete parse, so that
+  // handlers are only finished when all of the input has been seen
+  bool m_complete;
+};
+
+#endif // RECORDFANOUT_HPP
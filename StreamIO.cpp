@@ -0,0 +1,425 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "StreamIO.hpp"
+#include "ContentHash.hpp"
+
+#include <boost/algorithm/string.hpp>
+
+#include <zlib.h>
+#ifdef EPW_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <ios>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+FileInputBuffer::FileInputBuffer(FILE *file, std::size_t size) : m_file(file), m_size(size), m_bytes(0),
+  m_hash(nullptr)
+{
+}
+
+void FileInputBuffer::hashInto(ContentHash *hash)
+{
+  m_hash = hash;
+}
+
+unsigned long long FileInputBuffer::bytes() const
+{
+  return m_bytes;
+}
+
+FileInputBuffer::int_type FileInputBuffer::underflow()
+{
+  if(gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+  // The buffer is only allocated once it is used
+  if(m_buffer.empty()) {
+    m_buffer.resize(m_size);
+  }
+  std::size_t n = std::fread(&m_buffer[0], 1, m_buffer.size(), m_file);
+  if(!n) {
+    return traits_type::eof();
+  }
+  if(m_hash) {
+    m_hash->update(&m_buffer[0], n);
+  }
+  m_bytes += n;
+  setg(&m_buffer[0], &m_buffer[0], &m_buffer[0] + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+MemoryInputBuffer::MemoryInputBuffer(const char *data, std::size_t size)
+{
+  // The get area is never written through
+  char *begin = const_cast<char*>(data);
+  setg(begin, begin, begin + size);
+}
+
+FileOutputBuffer::FileOutputBuffer(FILE *file, std::size_t size) : m_file(file), m_size(size), m_bytes(0)
+{
+}
+
+unsigned long long FileOutputBuffer::bytes() const
+{
+  return m_bytes;
+}
+
+FileOutputBuffer::~FileOutputBuffer()
+{
+  sync();
+}
+
+bool FileOutputBuffer::flushBuffer()
+{
+  std::size_t n = pptr() - pbase();
+  if(n && std::fwrite(pbase(), 1, n, m_file) != n) {
+    return false;
+  }
+  m_bytes += n;
+  if(!m_buffer.empty()) {
+    setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+  }
+  return true;
+}
+
+FileOutputBuffer::int_type FileOutputBuffer::overflow(int_type c)
+{
+  // The buffer is only allocated once it is used
+  if(m_buffer.empty()) {
+    m_buffer.resize(m_size);
+    setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+  } else if(!flushBuffer()) {
+    return traits_type::eof();
+  }
+  if(!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int FileOutputBuffer::sync()
+{
+  if(!flushBuffer() || std::fflush(m_file) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+DecompressionBuffer::DecompressionBuffer(FILE *file, std::size_t size) : m_file(file), m_input(size / 4),
+  m_next(nullptr), m_available(0), m_inputLeft(~0ULL), m_hash(nullptr), m_output(size),
+  m_produced(0)
+{
+  setg(&m_output[0], &m_output[0], &m_output[0]);
+}
+
+DecompressionBuffer::~DecompressionBuffer()
+{
+}
+
+std::string DecompressionBuffer::error() const
+{
+  return m_error;
+}
+
+void DecompressionBuffer::hashInto(ContentHash *hash)
+{
+  m_hash = hash;
+}
+
+bool DecompressionBuffer::fillInput()
+{
+  std::size_t want = (std::size_t)std::min<unsigned long long>(m_input.size(), m_inputLeft);
+  if(!want) {
+    return false;
+  }
+  std::size_t n = std::fread(&m_input[0], 1, want, m_file);
+  if(!n) {
+    if(std::ferror(m_file)) {
+      m_error = "Failed to read compressed input";
+    }
+    return false;
+  }
+  if(m_hash) {
+    m_hash->update(&m_input[0], n);
+  }
+  m_next = &m_input[0];
+  m_available = n;
+  m_inputLeft -= n;
+  return true;
+}
+
+DecompressionBuffer::int_type DecompressionBuffer::underflow()
+{
+  if(gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+  std::size_t produced = 0;
+  if(!decompress(&m_output[0], m_output.size(), produced)) {
+    // The istream catches this and sets badbit, which is how the reader
+    // finds out that the data stopped early
+    throw std::ios_base::failure(m_error);
+  }
+  if(!produced) {
+    return traits_type::eof();
+  }
+  m_produced += produced;
+  setg(&m_output[0], &m_output[0], &m_output[0] + produced);
+  return traits_type::to_int_type(*gptr());
+}
+
+DecompressionBuffer::pos_type DecompressionBuffer::seekoff(off_type off, std::ios_base::seekdir dir,
+  std::ios_base::openmode which)
+{
+  if(off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::in)) {
+    return pos_type(off_type(-1));
+  }
+  return pos_type(off_type(m_produced - (egptr() - gptr())));
+}
+
+struct GzipInputBuffer::State
+{
+  z_stream stream;
+};
+
+GzipInputBuffer::GzipInputBuffer(FILE *file, std::size_t size) : DecompressionBuffer(file, size), m_state(new State),
+  m_inMember(false)
+{
+  std::memset(&m_state->stream, 0, sizeof(z_stream));
+  // 32 asks zlib to detect a gzip or zlib header
+  if(inflateInit2(&m_state->stream, 15 + 32) != Z_OK) {
+    m_error = "Failed to start gzip decompression";
+  }
+}
+
+GzipInputBuffer::~GzipInputBuffer()
+{
+  inflateEnd(&m_state->stream);
+  delete m_state;
+}
+
+bool GzipInputBuffer::decompress(char *output, std::size_t size, std::size_t &produced)
+{
+  produced = 0;
+  if(!m_error.empty()) {
+    return false;
+  }
+  z_stream &z = m_state->stream;
+  while(!produced) {
+    if(!m_available && !fillInput()) {
+      if(!m_error.empty()) {
+        return false;
+      }
+      if(m_inMember) {
+        m_error = "Compressed input is truncated";
+        return false;
+      }
+      return true;
+    }
+    z.next_in = (Bytef*)m_next;
+    z.avail_in = (uInt)m_available;
+    z.next_out = (Bytef*)output;
+    z.avail_out = (uInt)size;
+    int rc = inflate(&z, Z_NO_FLUSH);
+    m_next += m_available - z.avail_in;
+    m_available = z.avail_in;
+    produced = size - z.avail_out;
+    if(rc == Z_STREAM_END) {
+      // Another member may follow
+      m_inMember = false;
+      inflateReset(&z);
+    } else if(rc == Z_OK || rc == Z_BUF_ERROR) {
+      m_inMember = true;
+    } else {
+      m_error = "Compressed input is corrupt";
+      if(z.msg) {
+        m_error += std::string(" (") + z.msg + ")";
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+#ifdef EPW_HAVE_ZSTD
+struct ZstdInputBuffer::State
+{
+  ZSTD_DStream *stream;
+};
+
+ZstdInputBuffer::ZstdInputBuffer(FILE *file, std::size_t size) : DecompressionBuffer(file, size), m_state(new State),
+  m_inFrame(false)
+{
+  m_state->stream = ZSTD_createDStream();
+  if(!m_state->stream || ZSTD_isError(ZSTD_initDStream(m_state->stream))) {
+    m_error = "Failed to start zstd decompression";
+  }
+}
+
+ZstdInputBuffer::~ZstdInputBuffer()
+{
+  ZSTD_freeDStream(m_state->stream);
+  delete m_state;
+}
+
+bool ZstdInputBuffer::decompress(char *output, std::size_t size, std::size_t &produced)
+{
+  produced = 0;
+  if(!m_error.empty()) {
+    return false;
+  }
+  while(!produced) {
+    if(!m_available && !fillInput()) {
+      if(!m_error.empty()) {
+        return false;
+      }
+      if(m_inFrame) {
+        m_error = "Compressed input is truncated";
+        return false;
+      }
+      return true;
+    }
+    ZSTD_inBuffer in = {m_next, m_available, 0};
+    ZSTD_outBuffer out = {output, size, 0};
+    std::size_t rc = ZSTD_decompressStream(m_state->stream, &out, &in);
+    if(ZSTD_isError(rc)) {
+      m_error = std::string("Compressed input is corrupt (") + ZSTD_getErrorName(rc) + ")";
+      return false;
+    }
+    m_next += in.pos;
+    m_available -= in.pos;
+    produced = out.pos;
+    // Zero means a frame just finished, another may follow
+    m_inFrame = rc != 0;
+  }
+  return true;
+}
+#endif
+
+InputFile::InputFile() : m_file(nullptr), m_stream(nullptr)
+{
+}
+
+InputFile::~InputFile()
+{
+  close();
+}
+
+bool InputFile::open(const openstudio::path &path, std::string &message, ContentHash *rawHash)
+{
+  close();
+  m_file = std::fopen(path.string().c_str(), "rb");
+  if(!m_file) {
+    message = "Failed to open '" + path.string() + "'";
+    return false;
+  }
+
+  unsigned char magic[4] = {0, 0, 0, 0};
+  std::size_t n = std::fread(magic, 1, 4, m_file);
+  std::rewind(m_file);
+  if(n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    GzipInputBuffer *buffer = new GzipInputBuffer(m_file);
+    buffer->hashInto(rawHash);
+    m_buffer.reset(buffer);
+  } else if(n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+#ifdef EPW_HAVE_ZSTD
+    ZstdInputBuffer *buffer = new ZstdInputBuffer(m_file);
+    buffer->hashInto(rawHash);
+    m_buffer.reset(buffer);
+#else
+    message = "'" + path.string() + "' is compressed with zstd, which this build does not support";
+    close();
+    return false;
+#endif
+  } else {
+    FileInputBuffer *buffer = new FileInputBuffer(m_file);
+    buffer->hashInto(rawHash);
+    m_buffer.reset(buffer);
+  }
+  m_stream.rdbuf(m_buffer.get());
+  return true;
+}
+
+void InputFile::close()
+{
+  m_stream.rdbuf(nullptr);
+  m_buffer.reset();
+  if(m_file) {
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+}
+
+std::istream &InputFile::stream()
+{
+  return m_stream;
+}
+
+bool InputFile::compressed() const
+{
+  return dynamic_cast<DecompressionBuffer*>(m_buffer.get()) != nullptr;
+}
+
+std::string InputFile::error() const
+{
+  DecompressionBuffer *buffer = dynamic_cast<DecompressionBuffer*>(m_buffer.get());
+  if(buffer && !buffer->error().empty()) {
+    return buffer->error();
+  }
+  if(m_stream.bad()) {
+    return "Failed to read input";
+  }
+  return std::string();
+}
+
+bool isCompressedPath(const openstudio::path &path)
+{
+  std::string extension = path.extension().string();
+  return boost::algorithm::iequals(extension, ".gz") || boost::algorithm::iequals(extension, ".zst");
+}
+
+openstudio::path stripCompressionExtension(const openstudio::path &path)
+{
+  if(isCompressedPath(path)) {
+    openstudio::path stripped = path;
+    return stripped.replace_extension();
+  }
+  return path;
+}
+
+void setBinaryStandardStreams()
+{
+#ifdef _WIN32
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+bool isStandardStream(const openstudio::path &path)
+{
+  return path.string() == "-";
+}
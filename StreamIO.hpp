@@ -0,0 +1,214 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef STREAMIO_HPP
+#define STREAMIO_HPP
+
+#include <utilities/core/Path.hpp>
+
+#include <cstdio>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+class ContentHash;
+
+/** FileInputBuffer is a stream buffer that reads a C file, such as stdin, in
+ *  large blocks. */
+class FileInputBuffer : public std::streambuf
+{
+public:
+  explicit FileInputBuffer(FILE *file, std::size_t size=1 << 20);
+
+  /** Number of bytes read from the file so far. */
+  unsigned long long bytes() const;
+  /** Add every byte read from the file from now on to hash. */
+  void hashInto(ContentHash *hash);
+
+protected:
+  virtual int_type underflow();
+
+private:
+  FILE *m_file;
+  std::size_t m_size;
+  std::vector<char> m_buffer;
+  unsigned long long m_bytes;
+  ContentHash *m_hash;
+};
+
+/** MemoryInputBuffer reads a block of memory, such as part of a mapped file,
+ *  as a stream without copying it. */
+class MemoryInputBuffer : public std::streambuf
+{
+public:
+  MemoryInputBuffer(const char *data, std::size_t size);
+};
+
+/** FileOutputBuffer is a stream buffer that writes a C file, such as stdout,
+ *  in large blocks. Nothing is written until the buffer fills up or the
+ *  stream is flushed, so a line at a time output does not turn into a write
+ *  per line. */
+class FileOutputBuffer : public std::streambuf
+{
+public:
+  explicit FileOutputBuffer(FILE *file, std::size_t size=1 << 20);
+  virtual ~FileOutputBuffer();
+
+  /** Number of bytes written to the file so far. */
+  unsigned long long bytes() const;
+
+protected:
+  virtual int_type overflow(int_type c);
+  virtual int sync();
+
+private:
+  bool flushBuffer();
+
+  FILE *m_file;
+  std::size_t m_size;
+  std::vector<char> m_buffer;
+  unsigned long long m_bytes;
+};
+
+/** DecompressionBuffer is a stream buffer that reads compressed data from a C
+ *  file and decompresses it one block at a time, so that only a block of the
+ *  uncompressed data is ever held in memory. Corrupt or truncated input makes
+ *  the stream go bad and sets error. */
+class DecompressionBuffer : public std::streambuf
+{
+public:
+  virtual ~DecompressionBuffer();
+
+  /** Description of the failure that stopped decompression. */
+  std::string error() const;
+  /** Add every compressed byte read from the file from now on to hash. */
+  void hashInto(ContentHash *hash);
+
+protected:
+  DecompressionBuffer(FILE *file, std::size_t size);
+
+  virtual int_type underflow();
+  /** Only reports the position, so that tellg works, the data cannot be
+   *  sought in. */
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+
+  /** Decompress at least one byte into output unless the input is exhausted.
+   *  Returns false and sets m_error on failure. */
+  virtual bool decompress(char *output, std::size_t size, std::size_t &produced) = 0;
+
+  /** Read more compressed input once the last block has been used up.
+   *  Returns false at the end of the file or on a read error. */
+  bool fillInput();
+
+  FILE *m_file;
+  std::vector<char> m_input;
+  const char *m_next;
+  std::size_t m_available;
+  /** Bytes that may still be read from the file, for data that ends before
+   *  the file does, such as a member of an archive. Unlimited by default. */
+  unsigned long long m_inputLeft;
+  std::string m_error;
+  ContentHash *m_hash;
+
+private:
+  std::vector<char> m_output;
+  unsigned long long m_produced;
+};
+
+/** GzipInputBuffer decompresses gzip (or zlib) data, including files made of
+ *  several concatenated gzip members. */
+class GzipInputBuffer : public DecompressionBuffer
+{
+public:
+  explicit GzipInputBuffer(FILE *file, std::size_t size=1 << 20);
+  virtual ~GzipInputBuffer();
+
+protected:
+  virtual bool decompress(char *output, std::size_t size, std::size_t &produced);
+
+private:
+  struct State;
+  State *m_state;
+  bool m_inMember;
+};
+
+#ifdef EPW_HAVE_ZSTD
+/** ZstdInputBuffer decompresses Zstandard data, including files made of
+ *  several concatenated frames. */
+class ZstdInputBuffer : public DecompressionBuffer
+{
+public:
+  explicit ZstdInputBuffer(FILE *file, std::size_t size=1 << 20);
+  virtual ~ZstdInputBuffer();
+
+protected:
+  virtual bool decompress(char *output, std::size_t size, std::size_t &produced);
+
+private:
+  struct State;
+  State *m_state;
+  bool m_inFrame;
+};
+#endif
+
+/** InputFile opens a file for reading as a stream. Files that start with a
+ *  gzip header (or a Zstandard header, when built with zstd) are decompressed
+ *  on the fly, anything else is read as it is. */
+class InputFile
+{
+public:
+  InputFile();
+  ~InputFile();
+
+  /** Open a file. If rawHash is given, the bytes of the file as they are
+   *  read, before any decompression, are added to it. */
+  bool open(const openstudio::path &path, std::string &message, ContentHash *rawHash=nullptr);
+  void close();
+
+  std::istream &stream();
+  /** True if the file is being decompressed. */
+  bool compressed() const;
+  /** Description of the failure that made the stream go bad, if any. */
+  std::string error() const;
+
+private:
+  InputFile(const InputFile&);
+  InputFile& operator=(const InputFile&);
+
+  FILE *m_file;
+  std::unique_ptr<std::streambuf> m_buffer;
+  std::istream m_stream;
+};
+
+/** True if a path has a compressed file extension, .gz or .zst. */
+bool isCompressedPath(const openstudio::path &path);
+
+/** Path with any compressed file extension removed, so input.epw.gz gives
+ *  input.epw. */
+openstudio::path stripCompressionExtension(const openstudio::path &path);
+
+/** Put stdin and stdout into binary mode where that makes a difference. */
+void setBinaryStandardStreams();
+
+/** True if a path is "-", meaning stdin or stdout. */
+bool isStandardStream(const openstudio::path &path);
+
+#endif // STREAMIO_HPP
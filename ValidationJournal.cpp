@@ -0,0 +1,266 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#include "ValidationJournal.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char journalTag[] = "# epwtest journal ";
+
+// Tabs and newlines separate the journal, so they are escaped in the fields
+static std::string escapeField(const std::string &field)
+{
+  std::string escaped;
+  escaped.reserve(field.size());
+  for(char c : field) {
+    switch(c) {
+    case '\\':
+      escaped += "\\\\";
+      break;
+    case '\t':
+      escaped += "\\t";
+      break;
+    case '\n':
+      escaped += "\\n";
+      break;
+    case '\r':
+      escaped += "\\r";
+      break;
+    default:
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+static std::string unescapeField(const std::string &field)
+{
+  std::string text;
+  text.reserve(field.size());
+  for(std::size_t i=0;i<field.size();i++) {
+    if(field[i] != '\\' || i+1 == field.size()) {
+      text += field[i];
+      continue;
+    }
+    char c = field[++i];
+    text += c == 't' ? '\t' : (c == 'n' ? '\n' : (c == 'r' ? '\r' : c));
+  }
+  return text;
+}
+
+static bool parseEntry(const std::string &line, JournalEntry &entry)
+{
+  std::vector<std::string> fields;
+  std::size_t begin = 0;
+  while(true) {
+    std::size_t tab = line.find('\t', begin);
+    fields.push_back(unescapeField(line.substr(begin, tab == std::string::npos ? std::string::npos : tab - begin)));
+    if(tab == std::string::npos) {
+      break;
+    }
+    begin = tab + 1;
+  }
+  if(fields.size() != 4 || (fields[0] != "ok" && fields[0] != "fail")) {
+    return false;
+  }
+  entry.failed = fields[0] == "fail";
+  entry.path = fields[1];
+  entry.tier = fields[2];
+  entry.fields = fields[3];
+  return true;
+}
+
+// Read the journal, returning the length of its complete lines in length
+static bool loadJournal(const openstudio::path &path, std::vector<JournalEntry> &entries, std::string &options,
+  boost::uintmax_t &length, std::string &message)
+{
+  std::ifstream file(openstudio::toString(path).c_str(), std::ios_base::in | std::ios_base::binary);
+  if(!file) {
+    message = "Failed to open journal '" + openstudio::toString(path) + "'";
+    return false;
+  }
+  entries.clear();
+  length = 0;
+  std::string line;
+  bool first = true;
+  while(std::getline(file, line)) {
+    if(file.eof()) {
+      // No newline, the line was cut short
+      break;
+    }
+    length += line.size() + 1;
+    if(first) {
+      if(line.compare(0, sizeof(journalTag)-1, journalTag)) {
+        message = "'" + openstudio::toString(path) + "' is not an epwtest journal";
+        return false;
+      }
+      options = unescapeField(line.substr(sizeof(journalTag)-1));
+      first = false;
+      continue;
+    }
+    JournalEntry entry;
+    if(!parseEntry(line, entry)) {
+      message = "Malformed line in journal '" + openstudio::toString(path) + "'";
+      return false;
+    }
+    entries.push_back(entry);
+  }
+  if(first) {
+    message = "Journal '" + openstudio::toString(path) + "' is empty";
+    return false;
+  }
+  return true;
+}
+
+bool readJournal(const openstudio::path &path, std::vector<JournalEntry> &entries, std::string &options,
+  std::string &message)
+{
+  boost::uintmax_t length;
+  return loadJournal(path, entries, options, length, message);
+}
+
+ValidationJournal::ValidationJournal() : m_file(nullptr), m_sinceCheckpoint(0), m_checkpointVerdicts(64),
+  m_checkpointTime(std::chrono::seconds(5))
+{
+}
+
+ValidationJournal::~ValidationJournal()
+{
+  close();
+}
+
+void ValidationJournal::close()
+{
+  if(m_file) {
+    std::string message;
+    checkpoint(message);
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+}
+
+bool ValidationJournal::create(const openstudio::path &path, const std::string &options, std::string &message)
+{
+  close();
+  m_entries.clear();
+  m_file = std::fopen(openstudio::toString(path).c_str(), "wb");
+  if(!m_file) {
+    message = "Failed to create journal '" + openstudio::toString(path) + "': " + std::strerror(errno);
+    return false;
+  }
+  std::fprintf(m_file, "%s%s\n", journalTag, escapeField(options).c_str());
+  m_lastCheckpoint = std::chrono::steady_clock::now();
+  return checkpoint(message);
+}
+
+bool ValidationJournal::resume(const openstudio::path &path, const std::string &options, std::string &message)
+{
+  if(!boost::filesystem::exists(path)) {
+    return create(path, options, message);
+  }
+  close();
+  std::string journalOptions;
+  boost::uintmax_t length;
+  if(!loadJournal(path, m_entries, journalOptions, length, message)) {
+    return false;
+  }
+  if(journalOptions != options) {
+    message = "Journal '" + openstudio::toString(path) + "' was written with different options ("
+      + journalOptions + ")";
+    return false;
+  }
+  // Drop the partial line a crash may have left, so new verdicts start on a line of their own
+  boost::system::error_code ec;
+  boost::filesystem::resize_file(path, length, ec);
+  if(ec) {
+    message = "Failed to truncate journal '" + openstudio::toString(path) + "': " + ec.message();
+    return false;
+  }
+  m_file = std::fopen(openstudio::toString(path).c_str(), "ab");
+  if(!m_file) {
+    message = "Failed to open journal '" + openstudio::toString(path) + "': " + std::strerror(errno);
+    return false;
+  }
+  m_lastCheckpoint = std::chrono::steady_clock::now();
+  return true;
+}
+
+bool ValidationJournal::record(const JournalEntry &entry, std::string &message)
+{
+  if(!m_file) {
+    message = "Journal is not open";
+    return false;
+  }
+  std::string line = std::string(entry.failed ? "fail" : "ok") + "\t" + escapeField(entry.path) + "\t"
+    + escapeField(entry.tier) + "\t" + escapeField(entry.fields) + "\n";
+  if(std::fwrite(line.data(), 1, line.size(), m_file) != line.size()) {
+    message = std::string("Failed to write to journal: ") + std::strerror(errno);
+    return false;
+  }
+  if(++m_sinceCheckpoint >= m_checkpointVerdicts
+    || std::chrono::steady_clock::now() - m_lastCheckpoint >= m_checkpointTime) {
+    return checkpoint(message);
+  }
+  return true;
+}
+
+bool ValidationJournal::checkpoint(std::string &message)
+{
+  if(!m_file) {
+    return true;
+  }
+  m_sinceCheckpoint = 0;
+  m_lastCheckpoint = std::chrono::steady_clock::now();
+  if(std::fflush(m_file)) {
+    message = std::string("Failed to write to journal: ") + std::strerror(errno);
+    return false;
+  }
+#ifdef _WIN32
+  if(_commit(_fileno(m_file))) {
+#else
+  if(fsync(fileno(m_file))) {
+#endif
+    message = std::string("Failed to sync journal: ") + std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+void ValidationJournal::setCheckpointInterval(unsigned verdicts, double seconds)
+{
+  m_checkpointVerdicts = verdicts ? verdicts : 1;
+  m_checkpointTime = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(seconds));
+}
+
+const std::vector<JournalEntry> &ValidationJournal::entries() const
+{
+  return m_entries;
+}
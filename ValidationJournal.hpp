@@ -0,0 +1,95 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+
+#ifndef VALIDATIONJOURNAL_HPP
+#define VALIDATIONJOURNAL_HPP
+
+#include <utilities/core/Path.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/** One verdict in a validation journal: the file that was checked, the tier
+ *  that checked it ("header" or "data"), whether it failed and, if it did,
+ *  the CSV fields describing the failure. */
+struct JournalEntry
+{
+  JournalEntry() : failed(false)
+  {}
+  std::string path;
+  std::string tier;
+  bool failed;
+  std::string fields;
+};
+
+/** ValidationJournal is an append-only record of the verdicts of a long
+ *  validation run, so that a run that dies partway can be resumed without
+ *  checking again the files that already have a verdict. The journal is a
+ *  text file with a first line naming the options of the run and then one
+ *  tab separated verdict per line. Verdicts are buffered and the file is
+ *  flushed and synced to disk at checkpoints, every few verdicts or seconds,
+ *  so a crash loses at most the verdicts since the last checkpoint. A line
+ *  cut short by a crash is dropped when the journal is resumed. */
+class ValidationJournal
+{
+public:
+  ValidationJournal();
+  /** Checkpoint and close the journal. */
+  ~ValidationJournal();
+
+  /** Start a new journal, replacing any existing file. */
+  bool create(const openstudio::path &path, const std::string &options, std::string &message);
+  /** Open an existing journal to add to it, loading the verdicts already in
+   *  it. The journal must have been written with the same options. A journal
+   *  that does not exist yet is created. */
+  bool resume(const openstudio::path &path, const std::string &options, std::string &message);
+
+  /** Append a verdict, checkpointing if one is due. */
+  bool record(const JournalEntry &entry, std::string &message);
+  /** Flush the verdicts written so far and sync them to disk. */
+  bool checkpoint(std::string &message);
+  /** Checkpoint after this many verdicts or seconds, whichever comes first. */
+  void setCheckpointInterval(unsigned verdicts, double seconds);
+
+  /** Verdicts that were already in the journal when it was resumed. */
+  const std::vector<JournalEntry> &entries() const;
+
+private:
+  ValidationJournal(const ValidationJournal&);
+  ValidationJournal& operator=(const ValidationJournal&);
+
+  void close();
+
+  FILE *m_file;
+  std::vector<JournalEntry> m_entries;
+  unsigned m_sinceCheckpoint;
+  unsigned m_checkpointVerdicts;
+  std::chrono::steady_clock::duration m_checkpointTime;
+  std::chrono::steady_clock::time_point m_lastCheckpoint;
+};
+
+/** Read the verdicts in a journal along with the options it was written
+ *  with. An incomplete last line is ignored. */
+bool readJournal(const openstudio::path &path, std::vector<JournalEntry> &entries, std::string &options,
+  std::string &message);
+
+#endif // VALIDATIONJOURNAL_HPP
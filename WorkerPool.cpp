@@ -0,0 +1,156 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "WorkerPool.hpp"
+
+// The pool and index of the worker running on this thread, if any
+static thread_local WorkerPool *currentPool = nullptr;
+static thread_local unsigned currentWorker = 0;
+
+WorkerPool::WorkerPool(unsigned nThreads, std::size_t queueLimit) : m_queueLimit(queueLimit), m_queued(0),
+  m_pending(0), m_next(0), m_stopping(false)
+{
+  if(!nThreads) {
+    nThreads = hardwareThreads();
+  }
+  for(unsigned i=0;i<nThreads;i++) {
+    m_queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue));
+  }
+  for(unsigned i=0;i<nThreads;i++) {
+    m_threads.push_back(std::thread(&WorkerPool::run,this,i));
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+    m_work.notify_all();
+  }
+  for(std::thread &thread : m_threads) {
+    thread.join();
+  }
+}
+
+void WorkerPool::post(std::function<void()> task)
+{
+  bool fromWorker = currentPool == this;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  // A worker never waits for room, it could be the one that would make it
+  while(!fromWorker && m_queueLimit && m_queued >= m_queueLimit) {
+    m_notFull.wait(lock);
+  }
+  unsigned index = fromWorker ? currentWorker : m_next++ % m_queues.size();
+  ++m_pending;
+  ++m_queued;
+  {
+    std::lock_guard<std::mutex> queueLock(m_queues[index]->mutex);
+    m_queues[index]->tasks.push_back(std::move(task));
+  }
+  m_work.notify_one();
+}
+
+void WorkerPool::wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(m_pending) {
+    m_idle.wait(lock);
+  }
+  if(m_error) {
+    std::exception_ptr error = m_error;
+    m_error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+unsigned WorkerPool::size() const
+{
+  return (unsigned)m_threads.size();
+}
+
+unsigned WorkerPool::hardwareThreads()
+{
+  unsigned n = std::thread::hardware_concurrency();
+  if(!n) {
+    return 1;
+  }
+  return n;
+}
+
+bool WorkerPool::take(unsigned index, std::function<void()> &task)
+{
+  {
+    TaskQueue &own = *m_queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if(!own.tasks.empty()) {
+      task = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  for(std::size_t i=1;i<m_queues.size();i++) {
+    TaskQueue &other = *m_queues[(index + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if(!other.tasks.empty()) {
+      task = std::move(other.tasks.back());
+      other.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkerPool::run(unsigned index)
+{
+  currentPool = this;
+  currentWorker = index;
+  std::function<void()> task;
+  while(true) {
+    if(!take(index, task)) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while(!m_queued && !m_stopping) {
+        m_work.wait(lock);
+      }
+      if(!m_queued) {
+        return;
+      }
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      --m_queued;
+      m_notFull.notify_one();
+    }
+    std::exception_ptr error;
+    try {
+      task();
+    } catch(...) {
+      error = std::current_exception();
+    }
+    task = nullptr;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(error && !m_error) {
+      m_error = error;
+    }
+    if(!--m_pending) {
+      m_idle.notify_all();
+    }
+  }
+}
@@ -0,0 +1,218 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <boost/optional.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** BoundedQueue is a blocking FIFO queue. If a capacity is given, push blocks
+ *  until there is room, so a fast producer cannot run arbitrarily far ahead of
+ *  its consumers. */
+template <typename T> class BoundedQueue
+{
+public:
+  explicit BoundedQueue(std::size_t capacity=0) : m_capacity(capacity), m_closed(false)
+  {}
+
+  /** Add an item to the queue, returns false if the queue has been closed. */
+  bool push(T item)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!m_closed && m_capacity && m_items.size() >= m_capacity) {
+      m_notFull.wait(lock);
+    }
+    if(m_closed) {
+      return false;
+    }
+    m_items.push_back(std::move(item));
+    m_notEmpty.notify_one();
+    return true;
+  }
+
+  /** Remove an item from the queue, blocking until one is available. Returns
+   *  false once the queue has been closed and drained. */
+  bool pop(T &item)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(m_items.empty() && !m_closed) {
+      m_notEmpty.wait(lock);
+    }
+    if(m_items.empty()) {
+      return false;
+    }
+    item = std::move(m_items.front());
+    m_items.pop_front();
+    m_notFull.notify_one();
+    return true;
+  }
+
+  /** Stop accepting items, consumers see the remaining items and then stop. */
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+  }
+
+private:
+  std::size_t m_capacity;
+  bool m_closed;
+  std::deque<T> m_items;
+  std::mutex m_mutex;
+  std::condition_variable m_notEmpty;
+  std::condition_variable m_notFull;
+};
+
+/** WorkerPool runs posted tasks on a fixed number of threads. Each worker
+ *  has its own task queue: tasks posted from outside the pool are dealt out
+ *  to the queues in turn, and tasks posted by a task go on the queue of the
+ *  worker running it. A worker takes tasks from the front of its own queue,
+ *  so they run roughly in the order they were posted, and when that is empty
+ *  it steals from the back of the others, so that one slow task does not
+ *  leave the tasks queued behind it waiting while other workers sit idle.
+ *  Tasks should handle their own errors. An exception escaping a task is
+ *  caught so that it cannot take down the pool, and the first one is thrown
+ *  again from wait(). */
+class WorkerPool
+{
+public:
+  /** Start nThreads workers, zero means one per hardware thread. If queueLimit
+   *  is nonzero, post blocks while that many tasks are waiting. */
+  explicit WorkerPool(unsigned nThreads=0, std::size_t queueLimit=0);
+  /** Run the tasks that are still queued and stop the workers. */
+  ~WorkerPool();
+
+  /** Queue a task for execution. */
+  void post(std::function<void()> task);
+  /** Block until every task posted so far has finished. If any of them
+   *  threw, the first exception is rethrown here (once). */
+  void wait();
+  /** Number of worker threads. */
+  unsigned size() const;
+
+  /** Number of threads the hardware supports, at least one. */
+  static unsigned hardwareThreads();
+
+private:
+  WorkerPool(const WorkerPool&);
+  WorkerPool& operator=(const WorkerPool&);
+
+  struct TaskQueue
+  {
+    std::mutex mutex;
+    std::deque<std::function<void()> > tasks;
+  };
+
+  void run(unsigned index);
+  bool take(unsigned index, std::function<void()> &task);
+
+  std::vector<std::unique_ptr<TaskQueue> > m_queues;
+  std::vector<std::thread> m_threads;
+  std::size_t m_queueLimit;
+  std::size_t m_queued;
+  std::size_t m_pending;
+  unsigned m_next;
+  bool m_stopping;
+  std::exception_ptr m_error;
+  std::mutex m_mutex;
+  std::condition_variable m_work;
+  std::condition_variable m_notFull;
+  std::condition_variable m_idle;
+};
+
+/** OrderedResults collects results that are completed out of order by a
+ *  WorkerPool and hands them back in the order that the slots were reserved. */
+template <typename T> class OrderedResults
+{
+public:
+  /** Create an open collection, slots are added with reserve. */
+  OrderedResults() : m_base(0), m_closed(false)
+  {}
+
+  /** Create a closed collection with a fixed number of slots. */
+  explicit OrderedResults(std::size_t count) : m_slots(count), m_base(0), m_closed(true)
+  {}
+
+  /** Add a slot and return its index. */
+  std::size_t reserve()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots.push_back(boost::optional<T>());
+    return m_base + m_slots.size() - 1;
+  }
+
+  /** Store the result for a slot. */
+  void set(std::size_t index, T value)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots[index-m_base] = std::move(value);
+    m_ready.notify_all();
+  }
+
+  /** Indicate that no more slots will be reserved. */
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_ready.notify_all();
+  }
+
+  /** Call fn(index, value) for every result in slot order, blocking until the
+   *  collection is closed and every slot has been delivered. */
+  template <typename F> void drain(F fn)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true) {
+      while(!m_slots.empty() && m_slots.front()) {
+        T value = std::move(m_slots.front().get());
+        std::size_t index = m_base;
+        m_slots.pop_front();
+        ++m_base;
+        lock.unlock();
+        fn(index, value);
+        lock.lock();
+      }
+      if(m_closed && m_slots.empty()) {
+        return;
+      }
+      m_ready.wait(lock);
+    }
+  }
+
+private:
+  std::deque<boost::optional<T> > m_slots;
+  std::size_t m_base;
+  bool m_closed;
+  std::mutex m_mutex;
+  std::condition_variable m_ready;
+};
+
+#endif // WORKERPOOL_HPP
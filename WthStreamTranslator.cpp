@@ -0,0 +1,266 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include "WthStreamTranslator.hpp"
+
+#include <utilities/filetypes/EpwFile.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <cmath>
+#include <cstdio>
+
+void writeWthHeader(std::ostream &wth, const std::string &description, const EpwHeader &header)
+{
+  wth << "WeatherFile ContamW 2.0\n";
+  wth << description << "\n";
+  wth << header.startMonth << "/" << header.startDay << "\t!start date\n";
+  wth << header.endMonth << "/" << header.endDay << "\t!end date\n";
+  wth << "!Date\tDofW\tDtype\tDST\tTgrnd [K]\n";
+  // For now, DST is always 0 and the ground temperature is always 283.15 K
+  int dayOfWeek = header.startDayOfWeek;
+  int dayOfYear = header.startDayOfYear();
+  for(int i=0;i<header.numberOfDays();i++) {
+    int month, day;
+    epwMonthDay(dayOfYear+i, month, day, header.leapYear);
+    wth << month << "/" << day << "\t" << dayOfWeek << "\t" << dayOfWeek << "\t0\t283.15\n";
+    dayOfWeek++;
+    if(dayOfWeek > 7) {
+      dayOfWeek = 1;
+    }
+  }
+  wth << "!Date\tTime\tTa [K]\tPb [Pa]\tWs [m/s]\tWd [deg]\tHr [g/kg]\tIth [kJ/m^2]\tIdn [kJ/m^2]\tTs [K]\tRn [-]\tSn [-]\n";
+}
+
+void writeWthMidnightRow(std::ostream &wth, const std::string &row)
+{
+  std::string::size_type first = row.find('\t');
+  std::string::size_type second = first == std::string::npos ? first : row.find('\t', first+1);
+  if(second == std::string::npos) {
+    wth << row << "\n";
+    return;
+  }
+  wth << row.substr(0, first+1) << "00:00:00" << row.substr(second) << "\n";
+}
+
+bool translateEpwRecord(const std::string &line, unsigned long recordNumber, std::string &row, std::string &message)
+{
+  boost::optional<openstudio::EpwDataPoint> point = openstudio::EpwDataPoint::fromEpwString(line);
+  if(!point) {
+    message = "Failed to parse data record " + boost::lexical_cast<std::string>(recordNumber);
+    return false;
+  }
+  boost::optional<std::string> output = point->toWthString();
+  if(!output) {
+    message = "Translation to WTH has failed on data record " + boost::lexical_cast<std::string>(recordNumber);
+    return false;
+  }
+  row = output.get();
+  return true;
+}
+
+WthStreamTranslator::WthStreamTranslator(const std::string &description) : m_description(description), m_records(0)
+{
+}
+
+bool WthStreamTranslator::translate(std::istream &epw, std::ostream &wth)
+{
+  m_records = 0;
+  m_message.clear();
+
+  EpwHeader header;
+  if(!header.read(epw, m_message)) {
+    return false;
+  }
+  return translate(header, epw, wth);
+}
+
+bool WthStreamTranslator::translate(const EpwHeader &header, std::istream &epw, std::ostream &wth)
+{
+  m_records = 0;
+  m_message.clear();
+
+  writeWthHeader(wth, m_description, header);
+
+  std::string line;
+  while(std::getline(epw, line)) {
+    chompCarriageReturn(line);
+    if(line.empty()) {
+      continue;
+    }
+    std::string output;
+    if(!translateEpwRecord(line, m_records+1, output, m_message)) {
+      return false;
+    }
+    if(!m_records) {
+      writeWthMidnightRow(wth, output);
+    }
+    wth << output << "\n";
+    ++m_records;
+  }
+
+  if(m_records < 2) {
+    m_message = "Insufficient weather data for translation";
+    return false;
+  }
+
+  if(!wth) {
+    m_message = "Failed to write WTH output";
+    return false;
+  }
+  return true;
+}
+
+std::string WthStreamTranslator::message() const
+{
+  return m_message;
+}
+
+unsigned long WthStreamTranslator::records() const
+{
+  return m_records;
+}
+
+// Saturation pressure of water vapor in Pa for a temperature in K, equations 5
+// and 6 of ASHRAE Fundamentals 2009 chapter 1, as EpwDataPoint computes it
+static double saturationPressure(double T)
+{
+  double rhs;
+  if(T < 273.15) {
+    rhs = -5.6745359e+03/T + 6.3925247e+00 + T*(-9.6778430e-03 + T*(6.2215701e-07 + T*(2.0747825e-09
+      + T*-9.4840240e-13))) + 4.1635019e+00*std::log(T);
+  } else {
+    rhs = -5.8002206e+03/T + 1.3914993e+00 + T*(-4.8640239e-02 + T*(4.1764768e-05 + T*-1.4452093e-08))
+      + 6.5459673e+00*std::log(T);
+  }
+  return std::exp(rhs);
+}
+
+// EpwDataPoint has no value for a field that is empty or holds its missing code
+static bool missing(const EpwRecord &record, EpwField field, double missingValue)
+{
+  double value = record.values[field];
+  return value != value || value >= missingValue;
+}
+
+std::size_t formatWthRow(const EpwRecord &record, int recordsPerHour, char *buffer, std::size_t size,
+  std::string &message)
+{
+  const char *name = nullptr;
+  if(missing(record, EpwDryBulbTemperature, 99.9)) {
+    name = "dry bulb temperature";
+  } else if(missing(record, EpwAtmosphericStationPressure, 999999.0)) {
+    name = "atmospheric station pressure";
+  } else if(missing(record, EpwWindSpeed, 999.0)) {
+    name = "wind speed";
+  } else if(missing(record, EpwWindDirection, 999.0)) {
+    name = "wind direction";
+  } else if(missing(record, EpwDewPointTemperature, 99.9)) {
+    name = "dew point temperature";
+  } else if(missing(record, EpwGlobalHorizontalRadiation, 9999.0)) {
+    name = "global horizontal radiation";
+  } else if(missing(record, EpwDirectNormalRadiation, 9999.0)) {
+    name = "direct normal radiation";
+  } else if(missing(record, EpwHorizontalInfraredRadiationIntensity, 9999.0)) {
+    name = "horizontal infrared radiation intensity";
+  }
+  if(name) {
+    message = std::string("Missing ") + name + " on " + boost::lexical_cast<std::string>(record.month()) + "/"
+      + boost::lexical_cast<std::string>(record.day()) + " hour " + boost::lexical_cast<std::string>(record.hour());
+    return 0;
+  }
+
+  // EPW records are stamped with the end of the interval they cover
+  int minutes = record.hour()*60;
+  if(recordsPerHour > 1 && record.minute() > 0 && record.minute() < 60) {
+    minutes = (record.hour()-1)*60 + record.minute();
+  }
+
+  double pressure = record.values[EpwAtmosphericStationPressure];
+  double pw = saturationPressure(record.values[EpwDewPointTemperature] + 273.15);
+  double humidityRatio = 0.621945*pw/(pressure-pw);
+  double skyTemperature = std::pow(record.values[EpwHorizontalInfraredRadiationIntensity]/5.6697e-8, 0.25);
+  bool rain = !missing(record, EpwLiquidPrecipitationDepth, 999.0) && record.values[EpwLiquidPrecipitationDepth] > 0.0;
+  bool snow = !missing(record, EpwSnowDepth, 999.0) && record.values[EpwSnowDepth] > 0.0;
+
+  // %g is QString::number's default format, six significant digits
+  int n = std::snprintf(buffer, size, "%d/%d\t%02d:%02d:00\t%g\t%g\t%g\t%g\t%g\t%g\t%g\t%g\t%d\t%d",
+    record.month(), record.day(), minutes/60, minutes%60,
+    record.values[EpwDryBulbTemperature] + 273.15,
+    pressure,
+    record.values[EpwWindSpeed],
+    record.values[EpwWindDirection],
+    1000.0*humidityRatio,
+    3.6*record.values[EpwGlobalHorizontalRadiation],
+    3.6*record.values[EpwDirectNormalRadiation],
+    skyTemperature,
+    rain ? 1 : 0,
+    snow ? 1 : 0);
+  if(n <= 0 || (std::size_t)n >= size) {
+    message = "WTH row does not fit in the output buffer";
+    return 0;
+  }
+  return (std::size_t)n;
+}
+
+WthRecordWriter::WthRecordWriter(std::ostream &wth, const std::string &description) : m_wth(wth),
+  m_description(description), m_recordsPerHour(1), m_records(0)
+{
+}
+
+bool WthRecordWriter::header(const EpwHeader &header, std::string &message)
+{
+  m_recordsPerHour = header.recordsPerHour;
+  writeWthHeader(m_wth, m_description, header);
+  return true;
+}
+
+bool WthRecordWriter::record(const EpwRecord &record, std::string &message)
+{
+  char buffer[256];
+  std::size_t length = formatWthRow(record, m_recordsPerHour, buffer, sizeof(buffer), message);
+  if(!length) {
+    return false;
+  }
+  if(!m_records) {
+    writeWthMidnightRow(m_wth, std::string(buffer, length));
+  }
+  m_wth.write(buffer, length);
+  m_wth.put('\n');
+  ++m_records;
+  return true;
+}
+
+bool WthRecordWriter::finish(std::string &message)
+{
+  if(m_records < 2) {
+    message = "Insufficient weather data for translation";
+    return false;
+  }
+  if(!m_wth) {
+    message = "Failed to write WTH output";
+    return false;
+  }
+  return true;
+}
+
+unsigned long WthRecordWriter::records() const
+{
+  return m_records;
+}
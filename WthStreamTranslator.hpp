@@ -0,0 +1,106 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#ifndef WTHSTREAMTRANSLATOR_HPP
+#define WTHSTREAMTRANSLATOR_HPP
+
+#include "EpwHeader.hpp"
+#include "EpwReader.hpp"
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+/** Write the WTH preamble: the file identification, description, start and
+ *  end dates, the per-day table and the column heading for the data. This
+ *  reproduces what EpwFile::translateToWth writes before the data. */
+void writeWthHeader(std::ostream &wth, const std::string &description, const EpwHeader &header);
+
+/** Write a data row a second time with its time replaced by midnight. CONTAM
+ *  needs data at 00:00:00 on the start date, and like translateToWth the first
+ *  EPW record is used for it. */
+void writeWthMidnightRow(std::ostream &wth, const std::string &row);
+
+/** WthStreamTranslator translates EPW text to WTH text one record at a time.
+ *  Only the header and the current record are held in memory, so the cost in
+ *  memory is the same for an hourly file as for a one minute file. Records
+ *  are converted with EpwDataPoint, so on complete files the output is the
+ *  same as EpwFile::translateToWth. */
+class WthStreamTranslator
+{
+public:
+  explicit WthStreamTranslator(const std::string &description);
+
+  /** Translate the EPW on the input stream, returns false and sets message
+   *  on failure. The output is incomplete if the translation fails. */
+  bool translate(std::istream &epw, std::ostream &wth);
+  /** Translate the data records on the input stream for a header that has
+   *  already been read. The data period in the header is what goes into the
+   *  WTH, so a header cut down with EpwHeader::slice translates part of a
+   *  file. */
+  bool translate(const EpwHeader &header, std::istream &epw, std::ostream &wth);
+
+  /** Description of the last failure. */
+  std::string message() const;
+  /** Number of EPW data records translated by the last call to translate. */
+  unsigned long records() const;
+
+private:
+  std::string m_description;
+  std::string m_message;
+  unsigned long m_records;
+};
+
+/** Convert one EPW data line to a WTH data row (without a newline) with
+ *  EpwDataPoint, exactly as EpwFile::translateToWth does. Returns false and
+ *  sets message, naming the record number, if the line cannot be converted. */
+bool translateEpwRecord(const std::string &line, unsigned long recordNumber, std::string &row, std::string &message);
+
+/** Format an EPW record as a WTH data row (without a newline) in buffer.
+ *  Returns the length of the row, or zero with message set if a value that
+ *  CONTAM needs is missing. This is EpwDataPoint::toWthString carried over to
+ *  the parsed values: the same unit conversions (K, Pa, g/kg, kJ/m^2), the
+ *  same psychrometrics and the same six significant digit formatting, with no
+ *  text to tokenize. */
+std::size_t formatWthRow(const EpwRecord &record, int recordsPerHour, char *buffer, std::size_t size,
+  std::string &message);
+
+/** WthRecordWriter writes parsed EPW records to a stream as WTH, one
+ *  formatWthRow row per record, so records from the fast parser and from a
+ *  cache are written without going back through text. */
+class WthRecordWriter : public EpwRecordHandler
+{
+public:
+  WthRecordWriter(std::ostream &wth, const std::string &description);
+
+  virtual bool header(const EpwHeader &header, std::string &message);
+  virtual bool record(const EpwRecord &record, std::string &message);
+  virtual bool finish(std::string &message);
+
+  /** Number of EPW data records written. */
+  unsigned long records() const;
+
+private:
+  std::ostream &m_wth;
+  std::string m_description;
+  int m_recordsPerHour;
+  unsigned long m_records;
+};
+
+#endif // WTHSTREAMTRANSLATOR_HPP
@@ -28,22 +28,63 @@
 #include <model/SubSurface.hpp>
 #include <model/AirflowNetworkSimulationControl_Impl.hpp>
 #include <energyplus/ForwardTranslator.hpp>
-//#include <utilities/idd/AirflowNetwork_SimulationControl_FieldEnums.hxx>
+#include <utilities/idd/AirflowNetwork_SimulationControl_FieldEnums.hxx>
+#include <utilities/idd/AirflowNetwork_MultiZone_Zone_FieldEnums.hxx>
+#include <utilities/idd/AirflowNetwork_MultiZone_ReferenceCrackConditions_FieldEnums.hxx>
+#include <utilities/idd/AirflowNetwork_MultiZone_Surface_Crack_FieldEnums.hxx>
 #include <utilities/idd/AirflowNetwork_MultiZone_Surface_FieldEnums.hxx>
-//#include <utilities/idd/IddEnums.hxx>
-
+#include <utilities/idd/IddEnums.hxx>
+#include <utilities/idd/IddFactory.hxx>
+
+#include "InputList.hpp"
+#include "ProcessPool.hpp"
+#include "ResourceUsage.hpp"
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <iostream>
 
 using namespace openstudio;
 using namespace openstudio::model;
 
+/** Leakage element classes, used to index the per-class surface storage */
+enum LeakageElement {ExteriorElement=0, InteriorElement, LeakageElementCount};
+
+static const char *leakageElementName[LeakageElementCount] = {"ExteriorComponent", "InteriorComponent"};
+
+/** Struct-of-arrays bookkeeping for linked surfaces, one row per surface in link order */
+struct SurfaceTable
+{
+  std::vector<double> area;
+  std::vector<unsigned char> element;
+  std::vector<std::size_t> object; // Index into the surface objects of the row's element class
+
+  std::size_t size() const
+  {
+    return area.size();
+  }
+  void append(double surfaceArea, LeakageElement surfaceElement, std::size_t objectIndex)
+  {
+    area.push_back(surfaceArea);
+    element.push_back(surfaceElement);
+    object.push_back(objectIndex);
+  }
+};
+
 class AirflowNetworkBuilder : public openstudio::model::detail::SurfaceNetworkBuilder
 {
 public:
   explicit AirflowNetworkBuilder(bool linkSubSurfaces=false);
 
   std::vector<IdfObject> idfObjects();
+  /** Largest area of the surfaces linked to an element class. */
+  double maximumArea(LeakageElement element) const;
 
    virtual bool build(model::Model & model);
 
@@ -56,27 +97,27 @@ protected:
     const SubSurface &adjacentSubSurface, const Surface &adjacentSurface, const Space &adjacentSpace, const ThermalZone &adjacentZone);
 
 private:
-  bool linkSurface(const std::string &elementName, const Surface &surface, std::vector<IdfObject> &surfaces);
+  IdfObject crackObject(const std::string &name, double coefficient) const;
+  bool linkSurface(LeakageElement element, const Surface &surface);
   //std::vector<IdfObject> m_idfObjects;
   std::vector<IdfObject> m_airflowObjects;
-  std::vector<IdfObject> m_interiorSurfaces;
-  std::vector<IdfObject> m_exteriorSurfaces;
+  std::vector<IdfObject> m_surfaces[LeakageElementCount];
   bool m_includeSubSurfaces;
-  std::map<std::string,double> m_maxArea;
-  std::map<std::string,double> m_surfaceArea;
+  double m_maxArea[LeakageElementCount];
+  SurfaceTable m_surfaceTable;
 
   REGISTER_LOGGER("openstudio.model.detail.AirflowNetworkBuilder");
 };
 
 AirflowNetworkBuilder::AirflowNetworkBuilder(bool includeSubSurfaces) : SurfaceNetworkBuilder(nullptr),m_includeSubSurfaces(includeSubSurfaces)
 {
+  for(int i=0;i<LeakageElementCount;i++) {
+    m_maxArea[i] = 0.0;
+  }
 }
 
 std::vector<IdfObject> AirflowNetworkBuilder::idfObjects()
 {
-  std::cout << "Maximum exterior area: " << m_maxArea["ExteriorComponent"] << std::endl;
-  std::cout << "Maximum interior area: " << m_maxArea["InteriorComponent"] << std::endl;
-
   /*
   double maxArea = m_maxArea["Exterior"];
   if(m_maxArea["Interior"] > maxArea) {
@@ -84,97 +125,71 @@ std::vector<IdfObject> AirflowNetworkBuilder::idfObjects()
   }
   */
 
-  QStringList idfStrings;
-
-  idfStrings.clear();
-  idfStrings << "AirflowNetwork:MultiZone:ReferenceCrackConditions"
-    << "ReferenceCrackConditions"  // !- Name of Reference Crack Conditions
-    << "20.0"  // !- Reference Temperature for Crack Data {C}
-    << "101325"  // !- Reference Barometric Pressure for Crack Data {Pa}
-    << "0.0"; // !- Reference Humidity Ratio for Crack Data {kgWater/kgDryAir}
-  m_airflowObjects.push_back(openstudio::IdfObject::load((idfStrings.join(",")+";").toStdString()).get());
+  IdfObject conditions(IddObjectType::AirflowNetwork_MultiZone_ReferenceCrackConditions);
+  conditions.setString(AirflowNetwork_MultiZone_ReferenceCrackConditionsFields::Name, "ReferenceCrackConditions");
+  conditions.setDouble(AirflowNetwork_MultiZone_ReferenceCrackConditionsFields::ReferenceTemperature, 20.0); // {C}
+  conditions.setDouble(AirflowNetwork_MultiZone_ReferenceCrackConditionsFields::ReferenceBarometricPressure, 101325.0); // {Pa}
+  conditions.setDouble(AirflowNetwork_MultiZone_ReferenceCrackConditionsFields::ReferenceHumidityRatio, 0.0); // {kgWater/kgDryAir}
+  m_airflowObjects.push_back(conditions);
 
   // This is the "two elements to rule them all" approach
   // Generate exterior leakage element
-  idfStrings.clear();
-  idfStrings << "AirflowNetwork:MultiZone:Surface:Crack"
-    << "ExteriorComponent"  // !- Name of Surface Crack Component
-    << QString().sprintf("%g",m_maxArea["ExteriorComponent"]*4.99082e-4) // !- Air Mass Flow Coefficient at Reference Conditions {kg/s}
-    << "0.65"  // !- Air Mass Flow Exponent {dimensionless}
-    << "ReferenceCrackConditions"; // !- Reference Crack Conditions
-  m_airflowObjects.push_back(openstudio::IdfObject::load((idfStrings.join(",")+";").toStdString()).get());
-
+  m_airflowObjects.push_back(crackObject(leakageElementName[ExteriorElement], m_maxArea[ExteriorElement]*4.99082e-4));
   // Generate interior leakage element
-  idfStrings.clear();
-  idfStrings << "AirflowNetwork:MultiZone:Surface:Crack"
-    << "InteriorComponent"  // !- Name of Surface Crack Component
-    << QString().sprintf("%g",m_maxArea["InteriorComponent"]*2.0*4.99082e-4) // !- Air Mass Flow Coefficient at Reference Conditions {kg/s}
-    << "0.65"  // !- Air Mass Flow Exponent {dimensionless}
-    << "ReferenceCrackConditions"; // !- Reference Crack Conditions
-  m_airflowObjects.push_back(openstudio::IdfObject::load((idfStrings.join(",")+";").toStdString()).get());
-
-  std::vector<IdfObject> objects = m_airflowObjects;
-
-  // Set the multipliers on all the elements appropriately
-  double maxArea = m_maxArea["ExteriorComponent"];
-  BOOST_FOREACH(IdfObject obj, m_exteriorSurfaces) {
-    boost::optional<std::string> optName = obj.getString(AirflowNetwork_MultiZone_SurfaceFields::SurfaceName,false);
-    if(optName && m_surfaceArea[optName.get()]) {
-      if(obj.setDouble(AirflowNetwork_MultiZone_SurfaceFields::Window_DoorOpeningFactororCrackFactor,m_surfaceArea[optName.get()]/maxArea)) {
-        objects.push_back(obj);
-      }
+  m_airflowObjects.push_back(crackObject(leakageElementName[InteriorElement], m_maxArea[InteriorElement]*2.0*4.99082e-4));
+
+  // Set the multipliers on all the elements in one pass over the surface table
+  for(std::size_t i=0;i<m_surfaceTable.size();i++) {
+    unsigned char element = m_surfaceTable.element[i];
+    IdfObject &obj = m_surfaces[element][m_surfaceTable.object[i]];
+    if(!obj.setDouble(AirflowNetwork_MultiZone_SurfaceFields::Window_DoorOpeningFactororCrackFactor,
+      m_surfaceTable.area[i]/m_maxArea[element])) {
+      LOG(Error, "Failed to set the crack factor for AirflowNetwork surface " << i);
     }
   }
 
-  maxArea = m_maxArea["InteriorComponent"];
-  BOOST_FOREACH(IdfObject obj, m_interiorSurfaces) {
-    boost::optional<std::string> optName = obj.getString(AirflowNetwork_MultiZone_SurfaceFields::SurfaceName,false);
-    if(optName && m_surfaceArea[optName.get()]) {
-      if(obj.setDouble(AirflowNetwork_MultiZone_SurfaceFields::Window_DoorOpeningFactororCrackFactor,m_surfaceArea[optName.get()]/maxArea)) {
-        objects.push_back(obj);
-      }
-    }
-  }
-  
-  //objects.insert(objects.end(), m_exteriorSurfaces.begin(), m_exteriorSurfaces.end());
-  //objects.insert(objects.end(), m_interiorSurfaces.begin(), m_interiorSurfaces.end());
+  std::vector<IdfObject> objects = m_airflowObjects;
+  objects.insert(objects.end(), m_surfaces[ExteriorElement].begin(), m_surfaces[ExteriorElement].end());
+  objects.insert(objects.end(), m_surfaces[InteriorElement].begin(), m_surfaces[InteriorElement].end());
 
   return objects;
 }
 
+double AirflowNetworkBuilder::maximumArea(LeakageElement element) const
+{
+  return m_maxArea[element];
+}
+
+IdfObject AirflowNetworkBuilder::crackObject(const std::string &name, double coefficient) const
+{
+  IdfObject crack(IddObjectType::AirflowNetwork_MultiZone_Surface_Crack);
+  crack.setString(AirflowNetwork_MultiZone_Surface_CrackFields::Name, name);
+  crack.setDouble(AirflowNetwork_MultiZone_Surface_CrackFields::AirMassFlowCoefficientatReferenceConditions, coefficient); // {kg/s}
+  crack.setDouble(AirflowNetwork_MultiZone_Surface_CrackFields::AirMassFlowExponent, 0.65); // {dimensionless}
+  crack.setString(AirflowNetwork_MultiZone_Surface_CrackFields::ReferenceCrackConditions, "ReferenceCrackConditions");
+  return crack;
+}
+
 bool AirflowNetworkBuilder::build(model::Model & model)
 {
-  QStringList idfStrings;
   BOOST_FOREACH(openstudio::model::ThermalZone thermalZone, model.getConcreteModelObjects<openstudio::model::ThermalZone>()) {
     boost::optional<std::string> name = thermalZone.name();
     if(!name) {
       LOG(Error, "Thermal zone '" << thermalZone.handle() << "' has no name, translation aborted");
       return false;
     }
-    idfStrings.clear();
-    idfStrings << "AirflowNetwork:Multizone:Zone"
-      << openstudio::toQString(*name) // !- Name of Associated Thermal Zone
-      << "NoVent" // !- Ventilation Control Mode
-      << ""  // !- Vent Temperature Schedule Name
-      << ""  // !- Limit Value on Multiplier for Modulating Venting Open Factor {dimensionless}
-      << ""  // !- Lower Value on Inside/Outside Temperature Difference for
-      // !- Modulating the Venting Open Factor {deltaC}
-      << ""  // !- Upper Value on Inside/Outside Temperature Difference for
-      // !- Modulating the Venting Open Factor {deltaC}
-      << ""  // !- Lower Value on Inside/Outside Enthalpy Difference for Modulating
-      // !- the Venting Open Factor {J/kg}
-      << ""  // !- Upper Value on Inside/Outside Enthalpy Difference for Modulating
-      // !- the Venting Open Factor {J/kg}
-      << ""; // !- Venting Availability Schedule Name
-    m_airflowObjects.push_back(openstudio::IdfObject::load((idfStrings.join(",")+";").toStdString()).get());
+    // The remaining venting fields are left blank
+    IdfObject zone(IddObjectType::AirflowNetwork_MultiZone_Zone);
+    zone.setString(AirflowNetwork_MultiZone_ZoneFields::ZoneName, *name);
+    zone.setString(AirflowNetwork_MultiZone_ZoneFields::VentilationControlMode, "NoVent");
+    m_airflowObjects.push_back(zone);
   }
 
   return SurfaceNetworkBuilder::build(model);
 }
 
-bool AirflowNetworkBuilder::linkSurface(const std::string &elementName, const Surface &surface, std::vector<IdfObject> &surfaces)
+bool AirflowNetworkBuilder::linkSurface(LeakageElement element, const Surface &surface)
 {
-  QString idfFormat = QString("AirflowNetwork:MultiZone:Surface,%1,") + QString::fromStdString(elementName) + QString(",%2,%3;");
   boost::optional<std::string> name = surface.name();
   if(!name) {
     LOG(Warn, "Surface '" << openstudio::toString(surface.handle()) << "' has no name, will not be present in airflow network.");
@@ -186,35 +201,35 @@ bool AirflowNetworkBuilder::linkSurface(const std::string &elementName, const Su
   if(m_includeSubSurfaces) {
     surfaceArea = surface.netArea();
   }
-  std::map<std::string,double>::iterator it = m_maxArea.find(elementName);
-  if(it == m_maxArea.end()) {
-    m_maxArea[elementName] = surfaceArea;
-  } else {
-    if(it->second < surfaceArea) {
-      it->second = surfaceArea;
-    }
+  if(surfaceArea <= 0.0) {
+    LOG(Warn, "Surface '" << name.get() << "' has no area, will not be present in airflow network.");
+    return true;
   }
-  
-  m_surfaceArea[name.get()] = surfaceArea;
-  QString idfString = idfFormat.arg(openstudio::toQString(name.get())).arg("").arg(1);
-  boost::optional<IdfObject> obj = openstudio::IdfObject::load(idfString.toStdString());
-  if(!obj) {
+  if(m_maxArea[element] < surfaceArea) {
+    m_maxArea[element] = surfaceArea;
+  }
+
+  IdfObject obj(IddObjectType::AirflowNetwork_MultiZone_Surface);
+  if(!obj.setString(AirflowNetwork_MultiZone_SurfaceFields::SurfaceName, name.get())
+    || !obj.setString(AirflowNetwork_MultiZone_SurfaceFields::LeakageComponentName, leakageElementName[element])
+    || !obj.setDouble(AirflowNetwork_MultiZone_SurfaceFields::Window_DoorOpeningFactororCrackFactor, 1.0)) {
     LOG(Error, "Failed to generate AirflowNetwork surface for " << name.get());
     return false;
   }
-  surfaces.push_back(obj.get());
+  m_surfaceTable.append(surfaceArea, element, m_surfaces[element].size());
+  m_surfaces[element].push_back(obj);
   return true;
 }
 
 bool AirflowNetworkBuilder::linkExteriorSurface(const ThermalZone &zone, const Space &space, const Surface &surface)
 {
-  return linkSurface("ExteriorComponent", surface, m_exteriorSurfaces);
+  return linkSurface(ExteriorElement, surface);
 }
 
 bool AirflowNetworkBuilder::linkInteriorSurface(const ThermalZone &zone, const Space &space, const Surface &surface, 
   const Surface &adjacentSurface, const Space &adjacentSpace, const ThermalZone &adjacentZone)
 {
-  return linkSurface("InteriorComponent", surface, m_interiorSurfaces);
+  return linkSurface(InteriorElement, surface);
 }
 
 bool AirflowNetworkBuilder::linkExteriorSubSurface(const ThermalZone &zone, const Space &space, const Surface &surface, const SubSurface &subSurface)
@@ -228,21 +243,253 @@ bool AirflowNetworkBuilder::linkInteriorSubSurface(const ThermalZone &zone, cons
   return true;
 }
 
+/** Write the translated workspace followed by the AirflowNetwork objects
+ *  through a large buffer. The workspace objects are printed one at a time, so
+ *  the AirflowNetwork objects are never copied into the workspace and no
+ *  second copy of the whole model is made. */
+bool writeStreamingIdf(const openstudio::Workspace &workspace, const std::vector<openstudio::IdfObject> &idfObjects,
+  const openstudio::path &outPath, std::string &message)
+{
+  std::vector<char> buffer(1 << 20);
+  std::ofstream stream;
+  stream.rdbuf()->pubsetbuf(&buffer[0], buffer.size());
+  stream.open(outPath.string().c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+  if(!stream) {
+    message = "Could not open IDF file '" + openstudio::toString(outPath) + "'";
+    return false;
+  }
+  BOOST_FOREACH(const openstudio::WorkspaceObject &object, workspace.objects(true)) {
+    // The IDF form of the object has its references written as names
+    object.idfObject().print(stream);
+  }
+  BOOST_FOREACH(const openstudio::IdfObject &object, idfObjects) {
+    object.print(stream);
+  }
+  stream.close();
+  if(!stream) {
+    message = "Failed to write IDF file '" + openstudio::toString(outPath) + "'";
+    return false;
+  }
+  return true;
+}
+
+/** Options that apply to every model that is converted */
+struct ConversionOptions
+{
+  bool streaming;
+  bool verbose;
+};
+
+/** Translators that are set up once per process and reused for every model it converts */
+struct Translators
+{
+  openstudio::osversion::VersionTranslator versionTranslator;
+  openstudio::energyplus::ForwardTranslator forwardTranslator;
+};
+
+/** Create the simulation control object that goes with the generated network */
+openstudio::IdfObject simulationControlObject()
+{
+  openstudio::IdfObject control(openstudio::IddObjectType::AirflowNetwork_SimulationControl);
+  control.setString(openstudio::AirflowNetwork_SimulationControlFields::Name, "Automatic_AirflowNetwork");
+  control.setString(openstudio::AirflowNetwork_SimulationControlFields::AirflowNetworkControl, "MultiZoneWithoutDistribution");
+  control.setString(openstudio::AirflowNetwork_SimulationControlFields::WindPressureCoefficientType, "SurfaceAverageCalculation");
+  control.setString(openstudio::AirflowNetwork_SimulationControlFields::AirflowNetworkWindPressureCoefficientArrayName, "");
+  control.setString(openstudio::AirflowNetwork_SimulationControlFields::HeightSelectionforLocalWindPressureCalculation, "OpeningHeight");
+  control.setString(openstudio::AirflowNetwork_SimulationControlFields::BuildingType, "LowRise");
+  control.setInt(openstudio::AirflowNetwork_SimulationControlFields::MaximumNumberofIterations, 500); // {dimensionless}
+  control.setString(openstudio::AirflowNetwork_SimulationControlFields::InitializationType, "ZeroNodePressures");
+  control.setDouble(openstudio::AirflowNetwork_SimulationControlFields::RelativeAirflowConvergenceTolerance, 1.0E-05); // {dimensionless}
+  control.setDouble(openstudio::AirflowNetwork_SimulationControlFields::AbsoluteAirflowConvergenceTolerance, 1.0E-06); // {kg/s}
+  control.setDouble(openstudio::AirflowNetwork_SimulationControlFields::ConvergenceAccelerationLimit, -0.5); // {dimensionless}
+  control.setDouble(openstudio::AirflowNetwork_SimulationControlFields::AzimuthAngleofLongAxisofBuilding, 0.0); // {deg}
+  control.setDouble(openstudio::AirflowNetwork_SimulationControlFields::RatioofBuildingWidthAlongShortAxistoWidthAlongLongAxis, 1.0);
+  return control;
+}
+
+/** Translate an OSM file and write it, with an airflow network added, to an
+ *  IDF file next to it. Returns false and sets message on failure, otherwise
+ *  objectCount is set to the number of AirflowNetwork objects written. */
+bool convertModel(const openstudio::path &inputPath, Translators &translators, const ConversionOptions &options,
+  std::size_t &objectCount, std::string &message)
+{
+  if(!boost::filesystem::exists(inputPath)) {
+    message = "Input path does not exist.";
+    return false;
+  }
+
+  boost::optional<openstudio::model::Model> model = translators.versionTranslator.loadModel(inputPath);
+
+  if(!model) {
+    message = "Unable to load file '" + openstudio::toString(inputPath) + "' as an OpenStudio model.";
+    return false;
+  }
+
+  // Get an E+ workspace
+  openstudio::Workspace workspace = translators.forwardTranslator.translateModel(model.get(),nullptr);
+
+  // Add AFN objects
+  AirflowNetworkBuilder builder(false);
+  builder.build(model.get());
+  std::vector<openstudio::IdfObject> idfObjects = builder.idfObjects();
+  if(options.verbose) {
+    std::cout << "Maximum exterior area: " << builder.maximumArea(ExteriorElement) << std::endl;
+    std::cout << "Maximum interior area: " << builder.maximumArea(InteriorElement) << std::endl;
+  }
+  if(!idfObjects.size()) {
+    message = "No AirflowNetwork objects were added to model, no IDF output written.";
+    return false;
+  }
+
+  // Create a simulation control object
+  idfObjects.insert(idfObjects.begin(), simulationControlObject());
+  objectCount = idfObjects.size();
+
+  if(options.verbose) {
+    std::cout << "Peak memory before output: " << peakResidentBytes()/1048576.0 << " MB" << std::endl;
+  }
+
+  openstudio::path outPath = openstudio::path(inputPath).replace_extension(openstudio::toPath("idf").string());
+
+  if(options.streaming) {
+    if(options.verbose) {
+      std::cout << "Appending " << idfObjects.size() << " IDF objects to model output." << std::endl;
+    }
+    if(!writeStreamingIdf(workspace, idfObjects, outPath, message)) {
+      return false;
+    }
+  } else {
+    if(options.verbose) {
+      std::cout << "Adding " << idfObjects.size() << " IDF objects to model." << std::endl;
+    }
+
+    std::vector<openstudio::WorkspaceObject> workObjects = workspace.addObjects(idfObjects);
+    if(workObjects.empty()) {
+      message = "Failed to add IDF objects to model, no IDF output written.";
+      return false;
+    }
+
+    if(!workspace.save(outPath,true)) {
+      message = "Failed to write IDF file.";
+      return false;
+    }
+  }
+
+  if(options.verbose) {
+    std::cout << "Peak memory after output: " << peakResidentBytes()/1048576.0 << " MB" << std::endl;
+  }
+  return true;
+}
+
+/** Outcome of converting one model in a batch */
+struct ModelStatus
+{
+  ModelStatus() : converted(false), objects(0), seconds(0.0)
+  {}
+  bool converted;
+  std::string status;
+  std::size_t objects;
+  double seconds;
+  std::string message;
+};
+
+/** Convert one model of a batch, catching anything the translators throw so
+ *  that one bad model cannot stop the others. */
+ModelStatus convertBatchModel(const openstudio::path &inputPath, Translators &translators, const ConversionOptions &options)
+{
+  ModelStatus result;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  try {
+    result.converted = convertModel(inputPath, translators, options, result.objects, result.message);
+  } catch(std::exception &e) {
+    result.message = std::string("Conversion threw an exception: ") + e.what();
+  } catch(...) {
+    result.message = "Conversion threw an unknown exception";
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.status = result.converted ? "ok" : "failed";
+  return result;
+}
+
+// Worker replies are "<status>\0<objects> <seconds>\0<message>"
+std::string encodeStatus(const ModelStatus &result)
+{
+  std::ostringstream counts;
+  counts << std::setprecision(17) << result.objects << ' ' << result.seconds;
+  return result.status + '\0' + counts.str() + '\0' + result.message;
+}
+
+ModelStatus workerStatus(ProcessPool::Outcome outcome, const std::string &reply)
+{
+  ModelStatus result;
+  if(outcome != ProcessPool::Completed) {
+    result.status = outcome == ProcessPool::TimedOut ? "timeout" : "crash";
+    result.message = reply;
+    return result;
+  }
+  std::size_t split = reply.find('\0');
+  std::size_t messageSplit = split == std::string::npos ? split : reply.find('\0', split + 1);
+  if(messageSplit == std::string::npos) {
+    result.status = "failed";
+    result.message = "Malformed reply from worker";
+    return result;
+  }
+  result.status = reply.substr(0, split);
+  result.converted = result.status == "ok";
+  std::istringstream counts(reply.substr(split + 1, messageSplit - split - 1));
+  counts >> result.objects >> result.seconds;
+  result.message = reply.substr(messageSplit + 1);
+  return result;
+}
+
+/** Print one row per model, in input order. */
+void printStatusTable(const std::vector<openstudio::path> &inputPaths, const std::vector<ModelStatus> &results)
+{
+  std::cout << std::left << std::setw(8) << "Status" << std::right << std::setw(10) << "Objects" << std::setw(10) << "Seconds"
+    << "  Model" << std::endl;
+  for(std::size_t i=0;i<results.size();i++) {
+    const ModelStatus &result = results[i];
+    std::cout << std::left << std::setw(8) << result.status << std::right << std::setw(10);
+    if(result.converted) {
+      std::cout << result.objects;
+    } else {
+      std::cout << "-";
+    }
+    std::cout << std::setw(10) << std::fixed << std::setprecision(2) << result.seconds << "  "
+      << openstudio::toString(inputPaths[i]);
+    if(!result.message.empty()) {
+      std::cout << ": " << result.message;
+    }
+    std::cout << std::endl;
+  }
+}
+
 void usage( boost::program_options::options_description desc)
 {
   std::cout << "Usage: addafnidf --inputPath=./path/to/input.osm" << std::endl;
   std::cout << "   or: addafnidf input.osm" << std::endl;
+  std::cout << "   or: addafnidf --processes=8 first.osm second.osm @more.txt ./models/*.osm" << std::endl;
   std::cout << desc << std::endl;
 }
 
 int main(int argc, char *argv[])
 {
-  std::string inputPathString;
+  std::vector<std::string> inputPathStrings;
+  unsigned processCount = 0;
+  double timeout = 0;
+  ConversionOptions options;
 
   boost::program_options::options_description desc("Allowed options");
   desc.add_options()
     ("help", "print help message")
-    ("inputPath", boost::program_options::value<std::string>(&inputPathString), "path to OSM file");
+    ("inputPath", boost::program_options::value<std::vector<std::string> >(&inputPathStrings),
+      "path to OSM file, @file listing paths one per line, directory or wildcard pattern; more than one model is converted as a batch")
+    ("stream", "write the translated model and then append the AirflowNetwork objects, without adding them to the workspace")
+    ("processes,P", boost::program_options::value<unsigned>(&processCount),
+      "in a batch, number of worker processes converting models, 0 for one per hardware thread (the default);"
+      " a worker that crashes or hangs is replaced and its model is reported as a crash or timeout")
+    ("timeout", boost::program_options::value<double>(&timeout),
+      "in a batch, seconds a worker may spend on one model before it is killed, 0 for no limit (the default)");
   boost::program_options::positional_options_description pos;
   pos.add("inputPath", -1);
 
@@ -264,73 +511,89 @@ int main(int argc, char *argv[])
     usage(desc);
     return EXIT_SUCCESS;
   }
+  options.streaming = vm.count("stream") > 0;
   if(!vm.count("inputPath")) {
     std::cerr << "No input path given." << std::endl << std::endl;
     usage(desc);
     return EXIT_FAILURE;
   }
 
-  openstudio::path inputPath = openstudio::toPath(inputPathString);
-
-  if(!boost::filesystem::exists(inputPath)) {
-    std::cerr << "Input path does not exist." << std::endl;
+  std::vector<openstudio::path> inputPaths;
+  std::string message;
+  if(!expandInputs(inputPathStrings, ".osm", inputPaths, message)) {
+    std::cerr << message << std::endl;
     return EXIT_FAILURE;
   }
-
-  openstudio::osversion::VersionTranslator vt;
-  boost::optional<openstudio::model::Model> model = vt.loadModel(inputPath);
-
-  if(!model) {
-    std::cerr << "Unable to load file '"<< inputPathString << "' as an OpenStudio model." << std::endl;
+  if(inputPaths.empty()) {
+    std::cerr << "No OSM files found." << std::endl;
     return EXIT_FAILURE;
   }
 
-  // Get an E+ workspace
-  openstudio::energyplus::ForwardTranslator translator;
-  openstudio::Workspace workspace = translator.translateModel(model.get(),nullptr);
+  if(inputPaths.size() == 1 && !vm.count("processes")) {
+    // A single model is converted here, with its progress printed as it goes
+    Translators translators;
+    options.verbose = true;
+    std::size_t objectCount = 0;
+    if(!convertModel(inputPaths[0], translators, options, objectCount, message)) {
+      std::cerr << message << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
 
-  // Add AFN objects
-  AirflowNetworkBuilder builder;
-  builder.build(model.get());
-  std::vector<openstudio::IdfObject> idfObjects = builder.idfObjects();
-  if(!idfObjects.size()) {
-    std::cerr << "No AirflowNetwork objects were added to model, no IDF output written." << std::endl;
-    return EXIT_FAILURE;
+  options.verbose = false;
+  std::vector<ModelStatus> results(inputPaths.size());
+  if(ProcessPool::supported()) {
+    // The workers are forked before anything of OpenStudio (the IDD, the
+    // translators, the logger) has been set up in this process, so that none
+    // of its state or locks is shared across the fork. This process never
+    // sets them up, so replacement workers start from the same clean state.
+    if(!processCount) {
+      processCount = WorkerPool::hardwareThreads();
+    }
+    processCount = (unsigned)std::min<std::size_t>(processCount, inputPaths.size());
+    // Each worker has its own copy of this and fills it in on its first model
+    std::unique_ptr<Translators> translators;
+    ProcessPool processes(processCount, [&translators, &options](const std::string &request) {
+      if(!translators) {
+        openstudio::IddFactory::instance().getObject(openstudio::IddObjectType::AirflowNetwork_MultiZone_Surface);
+        translators.reset(new Translators);
+      }
+      return encodeStatus(convertBatchModel(openstudio::toPath(request), *translators, options));
+    }, timeout);
+    if(!processes.start(message)) {
+      std::cerr << message << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::vector<std::string> requests;
+    BOOST_FOREACH(const openstudio::path &inputPath, inputPaths) {
+      requests.push_back(openstudio::toString(inputPath));
+    }
+    processes.run(requests, [&](std::size_t i, ProcessPool::Outcome outcome, const std::string &reply) {
+      results[i] = workerStatus(outcome, reply);
+    });
+  } else {
+    // Without worker processes the models are converted one after another,
+    // sharing the IDD and translators set up once here
+    openstudio::IddFactory::instance().getObject(openstudio::IddObjectType::AirflowNetwork_MultiZone_Surface);
+    Translators translators;
+    for(std::size_t i=0;i<inputPaths.size();i++) {
+      results[i] = convertBatchModel(inputPaths[i], translators, options);
+    }
   }
 
-  // Create a simulation control object
-  QStringList idfStrings;
-  idfStrings << "AirflowNetwork:SimulationControl"
-    << "Automatic_AirflowNetwork"  // !- Name
-    << "MultiZoneWithoutDistribution"  // !- AirflowNetwork Control
-    << "SurfaceAverageCalculation"  // !- Wind Pressure Coefficient Type
-    << ""  // !- AirflowNetwork Wind Pressure Coefficient Array Name
-    << "OpeningHeight"  // !- Height Selection for Local Wind Speed Calculation
-    << "LowRise"  // !- Building Type
-    << "500"  // !- Maximum Number of Iterations {dimensionless}
-    << "ZeroNodePressures" // !- Initialization Type
-    << "1.0E-05"  // !- Relative Airflow Convergence Tolerance {dimensionless}
-    << "1.0E-06"  // !- Absolute Airflow Convergence Tolerance {kg/s}
-    << "-0.5"  // !- Convergence Acceleration Limit {dimensionless}
-    << "0.0"  // !- Azimuth Angle of Long Axis of Building {deg}
-    << "1.0";  // !- Ratio of Building Width Along Short Axis to Width Along Long Axis
-  idfObjects.insert(idfObjects.begin(),openstudio::IdfObject::load((idfStrings.join(",")+";").toStdString()).get());
-
-  std::cout << "Adding " << idfObjects.size() << " IDF objects to model." << std::endl;
-
- std::vector<openstudio::WorkspaceObject> workObjects = workspace.addObjects(idfObjects);
- if(workObjects.empty()) {
-   std::cerr << "Failed to add IDF objects to model, no IDF output written." << std::endl;
-   return EXIT_FAILURE;
- }
-  
-  openstudio::path outPath = inputPath.replace_extension(openstudio::toPath("idf").string());
-
-  if(!workspace.save(outPath,true)) {
-    std::cerr << "Failed to write IDF file." << std::endl;
-    return EXIT_FAILURE;
+  printStatusTable(inputPaths, results);
+  std::size_t failed = 0;
+  BOOST_FOREACH(const ModelStatus &result, results) {
+    if(!result.converted) {
+      ++failed;
+    }
   }
-  
-  return EXIT_SUCCESS;
-}
+  std::cout << inputPaths.size() - failed << " of " << inputPaths.size() << " models converted";
+  if(failed) {
+    std::cout << ", " << failed << " failed";
+  }
+  std::cout << std::endl;
 
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+/**********************************************************************
+ *  Copyright (c) 2014 Jason W. DeGraw
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ **********************************************************************/
+
+#include <utilities/core/CommandLine.hpp>
+#include <utilities/core/Path.hpp>
+
+#include "EpwValidator.hpp"
+#include "InputList.hpp"
+#include "StreamIO.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+void usage( boost::program_options::options_description desc)
+{
+  std::cout << "Usage: epwbench ./library/*.epw ./library/*.epw.gz" << std::endl;
+  std::cout << "   or: epwbench --repeat=5 --warm ./library" << std::endl;
+  std::cout << desc << std::endl;
+}
+
+// Drop a file's pages from the operating system's cache so that the next read
+// comes from storage. This is best effort: it only works on systems with
+// posix_fadvise, and pages that are in use elsewhere may stay cached.
+bool evictFromCache(const openstudio::path &path)
+{
+#if defined(_WIN32) || defined(__APPLE__)
+  return false;
+#else
+  int fd = ::open(path.string().c_str(), O_RDONLY);
+  if(fd < 0) {
+    return false;
+  }
+  bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+  ::close(fd);
+  return ok;
+#endif
+}
+
+std::string formatOf(const openstudio::path &path)
+{
+  std::string extension = path.extension().string();
+  if(boost::algorithm::iequals(extension, ".gz")) {
+    return "gzip";
+  } else if(boost::algorithm::iequals(extension, ".zst")) {
+    return "zstd";
+  }
+  return "epw";
+}
+
+struct FormatTotals
+{
+  FormatTotals() : files(0), failures(0), bytes(0), records(0), seconds(0)
+  {}
+
+  unsigned files;
+  unsigned failures;
+  boost::uintmax_t bytes;
+  unsigned long records;
+  double seconds;
+};
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::string> inputPathStrings;
+  unsigned repeat = 3;
+  boost::program_options::options_description desc("Allowed options");
+
+  desc.add_options()
+    ("help,h", "print help message")
+    ("input-path,i", boost::program_options::value<std::vector<std::string> >(&inputPathStrings),
+      "path to input EPW file (.epw, .epw.gz or .epw.zst), @file listing EPW files, directory, or wildcard pattern (may be repeated)")
+    ("repeat,r", boost::program_options::value<unsigned>(&repeat), "number of times to read each file, the median time is reported (default 3)")
+    ("warm", "leave files in the operating system's cache between reads instead of evicting them")
+    ("quiet,q", "only print the totals");
+
+  boost::program_options::positional_options_description pos;
+  pos.add("input-path", -1);
+
+  boost::program_options::variables_map vm;
+  try {
+    boost::program_options::store(boost::program_options::command_line_parser(argc,
+      argv).options(desc).positional(pos).run(), vm);
+    boost::program_options::notify(vm);
+  } catch(std::exception&) {
+    std::cout << "Execution failed: check arguments and retry."<< std::endl << std::endl;
+    usage(desc);
+    return EXIT_FAILURE;
+  }
+
+  if(vm.count("help")) {
+    usage(desc);
+    return EXIT_SUCCESS;
+  }
+
+  if(!vm.count("input-path")) {
+    std::cout << "No input path given." << std::endl << std::endl;
+    usage(desc);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<openstudio::path> inputPaths;
+  std::string message;
+  if(!expandInputs(inputPathStrings, ".epw", inputPaths, message)) {
+    std::cout << message << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(inputPaths.empty()) {
+    std::cout << "No EPW files found." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(!repeat) {
+    repeat = 1;
+  }
+
+  bool cold = vm.count("warm") == 0;
+  bool quiet = vm.count("quiet") > 0;
+  bool evicted = true;
+  std::map<std::string, FormatTotals> totals;
+
+  for(const openstudio::path &path : inputPaths) {
+    FormatTotals &total = totals[formatOf(path)];
+    ++total.files;
+    boost::system::error_code ec;
+    boost::uintmax_t bytes = boost::filesystem::file_size(path, ec);
+    if(ec) {
+      bytes = 0;
+    }
+
+    // Read the file the same way the tools do: mapped when uncompressed,
+    // decompressed into the parser a block at a time otherwise
+    std::vector<double> times;
+    unsigned long records = 0;
+    bool ok = true;
+    for(unsigned i=0;i<repeat && ok;i++) {
+      if(cold) {
+        evicted = evictFromCache(path) && evicted;
+      }
+      EpwValidator validator;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      ok = parseEpwInput(path, validator, message);
+      times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      records = validator.records();
+    }
+    if(!ok) {
+      ++total.failures;
+      std::cout << "FAILED " << openstudio::toString(path) << ": " << message << std::endl;
+      continue;
+    }
+
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    total.bytes += bytes;
+    total.records += records;
+    total.seconds += median;
+    if(!quiet) {
+      std::cout << std::fixed << std::setprecision(2) << openstudio::toString(path) << ": " << bytes << " bytes, "
+        << records << " records, " << 1000.0*median << " ms" << std::endl;
+    }
+  }
+
+  if(cold && !evicted) {
+    std::cout << "Warning: files could not be evicted from the cache, times may be warm." << std::endl;
+  }
+
+  std::cout << (cold ? "Cold" : "Warm") << " cache, median of " << repeat << " reads per file:" << std::endl;
+  std::map<std::string, FormatTotals>::const_iterator plain = totals.find("epw");
+  for(const auto &entry : totals) {
+    const FormatTotals &total = entry.second;
+    std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(5) << entry.first << std::right
+      << total.files - total.failures << " files, " << total.bytes / 1048576.0 << " MB on disk, " << total.records
+      << " records, " << 1000.0*total.seconds << " ms";
+    if(total.seconds > 0) {
+      std::cout << ", " << total.records / total.seconds << " records/s";
+    }
+    if(entry.first != "epw" && plain != totals.end() && plain->second.records && total.records) {
+      // Compare time per record, so that the two sets need not be identical
+      double ratio = (total.seconds / total.records) / (plain->second.seconds / plain->second.records);
+      std::cout << ", " << ratio << "x the uncompressed time per record";
+    }
+    std::cout << std::endl;
+  }
+
+  for(const auto &entry : totals) {
+    if(entry.second.failures) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -24,35 +24,880 @@
 #include <utilities/sql/SqlFile.hpp>
 #include <utilities/filetypes/EpwFile.hpp>
 
+#include "ArchiveReader.hpp"
+#include "CheckReport.hpp"
+#include "ContentHash.hpp"
+#include "EpwValidator.hpp"
+#include "InputList.hpp"
+#include "LogCapture.hpp"
+#include "ProcessPool.hpp"
+#include "Profile.hpp"
+#include "StreamIO.hpp"
+#include "ValidationJournal.hpp"
+#include "WorkerPool.hpp"
+
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <future>
 #include <string>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
 #include <QFile>
 
 void usage( boost::program_options::options_description desc)
 {
   std::cout << "Usage: epwtest --input-path=./path/to/input.txt" << std::endl;
   std::cout << "   or: epwtest input.txt" << std::endl;
+  std::cout << "   or: epwtest path/to/epw/directory" << std::endl;
+  std::cout << "   or: epwtest path/to/weather.zip" << std::endl;
   std::cout << desc << std::endl;
 }
 
-void mineSink(QTextStream &stream, openstudio::StringStreamLogSink &sink)
+/** The outcome of checking one EPW file: the CSV fields to record after the
+ *  path when it failed, the text to show on the console and what the check
+ *  took. */
+struct TestResult
+{
+  TestResult() : failed(false)
+  {}
+  bool failed;
+  std::string fields;
+  std::string console;
+  CheckTiming timing;
+};
+
+std::string capturedMessages(LogCapture &capture)
+{
+  std::string messages;
+  for(const std::string &mesg : capture.messages()) {
+    messages += "," + mesg;
+  }
+  if(capture.dropped()) {
+    messages = "," + std::to_string(capture.dropped()) + " earlier messages dropped" + messages;
+  }
+  return messages;
+}
+
+/** Check one EPW file, this is run on the worker pool so everything it
+ *  reports goes into the result rather than straight to the outputs. */
+TestResult testEpw(const std::string &line, bool fastParser)
+{
+  TestResult result;
+  openstudio::path epwPath = openstudio::toPath(line);
+  // EpwFile can only read uncompressed files, so compressed files are
+  // always checked by streaming them through the validator
+  if(fastParser || isCompressedPath(epwPath)) {
+    EpwValidator validator;
+    std::string message;
+    if(!parseEpwInput(epwPath, validator, message)) {
+      result.failed = true;
+      result.fields = message;
+      result.console = message;
+    }
+    result.timing.rows = validator.records();
+    return result;
+  }
+  // Only collect the messages logged by this thread, the other workers are
+  // reading their own files at the same time
+  LogCapture capture("openstudio\\.EpwFile");
+  boost::optional<openstudio::EpwFile> epwFile;
+  try {
+    epwFile = openstudio::EpwFile(epwPath,true);
+    if(!epwFile) {
+      result.failed = true;
+      result.fields = "returned" + capturedMessages(capture);
+      result.console = "Failed to read " + line;
+    } else {
+      result.timing.rows = epwFile->data().size();
+    }
+  } catch(openstudio::Exception &e) {
+    result.failed = true;
+    result.fields = e.message() + capturedMessages(capture);
+    result.console = e.message();
+  } catch(...) {
+    result.failed = true;
+    result.fields = "exception" + capturedMessages(capture);
+    result.console = "Caught exception...";
+  }
+  return result;
+}
+
+/** Check the header and size of one EPW file without reading its data. */
+TestResult triageEpw(const std::string &line)
+{
+  TestResult result;
+  std::string message;
+  if(!triageEpwFile(openstudio::toPath(line), message)) {
+    result.failed = true;
+    result.fields = message;
+    result.console = message;
+  }
+  return result;
+}
+
+/** The checks that can be run on a file. */
+enum CheckTier { HeaderTier = 'h', DataTier = 'd' };
+
+/** Check a member of a zip or tar archive, named archive!member. EpwFile can
+ *  only read a file on disk, so members are always streamed through the
+ *  validator, and triage checks the header and the size without the end. */
+TestResult checkArchiveMember(CheckTier tier, const std::string &reference)
+{
+  TestResult result;
+  std::string message;
+  ArchiveReader *reader = openArchiveMember(reference, message);
+  bool passed;
+  if(reader) {
+    result.timing.bytes = reader->size();
+  }
+  if(!reader) {
+    passed = false;
+  } else if(!reader->error().empty()) {
+    passed = false;
+    message = reader->error();
+  } else if(tier == HeaderTier) {
+    passed = triageEpwStream(reader->stream(), reader->size(), message);
+  } else {
+    EpwValidator validator;
+    passed = parseEpwStream(reader->stream(), validator, message);
+    result.timing.rows = validator.records();
+  }
+  if(!passed) {
+    if(reader && !reader->error().empty()) {
+      message = reader->error();
+    }
+    result.failed = true;
+    result.fields = message;
+    result.console = message;
+  }
+  return result;
+}
+
+/** Size of a file or a member of an archive, zero if it cannot be had. */
+boost::uint64_t inputSize(const std::string &path)
+{
+  openstudio::path archive;
+  std::string member;
+  if(splitArchiveMember(path, archive, member)) {
+    std::string message;
+    ArchiveReader *reader = openArchiveMember(path, message);
+    return reader ? reader->size() : 0;
+  }
+  boost::system::error_code ec;
+  boost::uint64_t size = boost::filesystem::file_size(openstudio::toPath(path), ec);
+  return ec ? 0 : size;
+}
+
+TestResult runCheckTier(CheckTier tier, const std::string &line, bool fastParser)
+{
+  openstudio::path archive;
+  std::string member;
+  if(splitArchiveMember(line, archive, member)) {
+    return checkArchiveMember(tier, line);
+  }
+  if(tier == HeaderTier) {
+    return triageEpw(line);
+  }
+  return testEpw(line, fastParser);
+}
+
+/** Check a file with the given tier, timing the check. The memory growth is
+ *  that of the process's peak, which other checks running at the same time
+ *  add to as well, it is only the file's own with one job or in a worker
+ *  process. */
+TestResult checkEpw(CheckTier tier, const std::string &line, bool fastParser)
+{
+  openstudio::path archive;
+  std::string member;
+  boost::uint64_t peakBefore = peakResidentBytes();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  TestResult result = runCheckTier(tier, line, fastParser);
+  result.timing.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  boost::uint64_t peakAfter = peakResidentBytes();
+  result.timing.memoryGrowth = peakAfter > peakBefore ? peakAfter - peakBefore : 0;
+  // Members give their size as they are read, asking for it again could mean
+  // going back through a compressed archive
+  if(!result.timing.bytes && !splitArchiveMember(line, archive, member)) {
+    result.timing.bytes = inputSize(line);
+  }
+  return result;
+}
+
+/** The result of a check for a copy of the file that was checked, which took
+ *  nothing of its own. */
+TestResult sharedResult(const TestResult &result)
+{
+  TestResult shared = result;
+  shared.timing.shared = true;
+  shared.timing.seconds = 0;
+  shared.timing.memoryGrowth = 0;
+  return shared;
+}
+
+/** Where the contents of a file are read from. Members of archives are
+ *  checked by the validator whatever the parser, so they must not share
+ *  verdicts with a copy on disk that EpwFile checked. */
+enum ContentSource { FileSource, ArchiveSource };
+
+/** Identifies the contents of a file by where they are read from, their
+ *  hash and their size. */
+typedef std::tuple<ContentSource, boost::uint64_t, boost::uint64_t> ContentKey;
+
+/** Content key of a file given the hash and size of its contents. */
+ContentKey makeContentKey(const std::string &path, boost::uint64_t hash, boost::uint64_t size)
+{
+  openstudio::path archive;
+  std::string member;
+  return ContentKey(splitArchiveMember(path, archive, member) ? ArchiveSource : FileSource, hash, size);
+}
+
+/** Hash a file or a member of an archive. */
+bool hashInput(const std::string &path, boost::uint64_t &hash, boost::uint64_t &size, std::string &message)
+{
+  openstudio::path archive;
+  std::string member;
+  if(!splitArchiveMember(path, archive, member)) {
+    return hashFile(openstudio::toPath(path), hash, size, message);
+  }
+  ArchiveReader *reader = openArchiveMember(path, message);
+  return reader && reader->error().empty() && hashStream(reader->stream(), hash, size, message);
+}
+
+/** VerdictCache shares verdicts between files with identical contents, so
+ *  that each distinct file is only checked once by each tier however many
+ *  copies of it there are under other names. Files are told apart by a fast
+ *  hash of their contents and their size. */
+class VerdictCache
+{
+public:
+  VerdictCache() : m_hits(0), m_misses(0)
+  {}
+
+  /** Content key of a file, hashing it the first time it is asked for unless
+   *  hash is false. Returns false if the file cannot be read. */
+  bool contentKey(const std::string &path, ContentKey &key, bool hash=true)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto found = m_keys.find(path);
+      if(found != m_keys.end()) {
+        key = found->second;
+        return true;
+      }
+    }
+    std::string message;
+    boost::uint64_t contentHash, size;
+    if(!hash || !hashInput(path, contentHash, size, message)) {
+      return false;
+    }
+    key = makeContentKey(path, contentHash, size);
+    setContentKey(path, key);
+    return true;
+  }
+
+  /** Record a content key computed elsewhere. */
+  void setContentKey(const std::string &path, const ContentKey &key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_keys[path] = key;
+  }
+
+  /** Check a file, or if a copy of it has already been checked by this tier
+   *  return that verdict, waiting for the check to finish if need be. */
+  TestResult check(CheckTier tier, const std::string &path, bool fastParser)
+  {
+    ContentKey key;
+    if(!contentKey(path, key)) {
+      // The check will say what is wrong with the file
+      return checkEpw(tier, path, fastParser);
+    }
+    std::promise<TestResult> promise;
+    std::shared_future<TestResult> verdict;
+    bool first = false;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto found = m_verdicts.find(std::make_pair(tier, key));
+      if(found == m_verdicts.end()) {
+        verdict = promise.get_future().share();
+        m_verdicts[std::make_pair(tier, key)] = verdict;
+        first = true;
+      } else {
+        verdict = found->second;
+      }
+    }
+    if(first) {
+      countMiss();
+      // Copies waiting on this check get its exception if it throws
+      try {
+        promise.set_value(checkEpw(tier, path, fastParser));
+      } catch(...) {
+        promise.set_exception(std::current_exception());
+      }
+      return verdict.get();
+    }
+    countHit();
+    return sharedResult(verdict.get());
+  }
+
+  void countHit()
+  {
+    ++m_hits;
+  }
+  void countMiss()
+  {
+    ++m_misses;
+  }
+  /** Number of checks answered with the verdict for a copy. */
+  unsigned hits() const
+  {
+    return m_hits;
+  }
+  /** Number of checks actually run. */
+  unsigned misses() const
+  {
+    return m_misses;
+  }
+
+private:
+  std::mutex m_mutex;
+  std::map<std::string, ContentKey> m_keys;
+  std::map<std::pair<CheckTier, ContentKey>, std::shared_future<TestResult> > m_verdicts;
+  std::atomic<unsigned> m_hits;
+  std::atomic<unsigned> m_misses;
+};
+
+/** Run a check, through the verdict cache if there is one. A check that
+ *  throws fails the file, so every task still hands back a result. */
+TestResult runCheck(VerdictCache *cache, CheckTier tier, const std::string &path, bool fastParser)
+{
+  TestResult result;
+  try {
+    if(cache) {
+      return cache->check(tier, path, fastParser);
+    }
+    return checkEpw(tier, path, fastParser);
+  } catch(std::exception &e) {
+    result.fields = std::string("exception,") + e.what();
+    result.console = std::string("Caught exception: ") + e.what();
+  } catch(...) {
+    result.fields = "exception";
+    result.console = "Caught exception...";
+  }
+  result.failed = true;
+  return result;
+}
+
+/** Check a file in a worker process. Requests are the tier letter followed
+ *  by the path, replies the failed flag followed by the CSV fields, the
+ *  console text and the bytes, rows, seconds and memory growth of the check,
+ *  separated by NULs. A request starting with # asks for the
+ *  content hash and size of the file instead, as hexadecimal and decimal
+ *  separated by a space, with an empty reply if it cannot be read. */
+std::string checkInWorker(const std::string &request, bool fastParser)
+{
+  if(request[0] == '#') {
+    boost::uint64_t hash, size;
+    std::string message;
+    if(!hashInput(request.substr(1), hash, size, message)) {
+      return std::string();
+    }
+    return ContentHash::toHex(hash) + " " + std::to_string(size);
+  }
+  TestResult result = checkEpw((CheckTier)request[0], request.substr(1), fastParser);
+  std::ostringstream timing;
+  timing.precision(17);
+  timing << result.timing.bytes << " " << result.timing.rows << " " << result.timing.seconds << " "
+    << result.timing.memoryGrowth;
+  return std::string(result.failed ? "1" : "0") + result.fields + '\0' + result.console + '\0' + timing.str();
+}
+
+TestResult workerResult(ProcessPool::Outcome outcome, const std::string &reply)
 {
-  for(openstudio::LogMessage mesg : sink.logMessages()) {
-    stream << "," << mesg.logMessage();
+  TestResult result;
+  if(outcome == ProcessPool::Completed) {
+    std::size_t split = reply.find('\0');
+    std::size_t timingSplit = split == std::string::npos ? split : reply.find('\0', split + 1);
+    result.failed = !reply.empty() && reply[0] == '1';
+    result.fields = reply.substr(1, split == std::string::npos ? std::string::npos : split - 1);
+    if(split != std::string::npos) {
+      result.console = reply.substr(split + 1, timingSplit == std::string::npos ? std::string::npos : timingSplit - split - 1);
+    }
+    if(timingSplit != std::string::npos) {
+      std::istringstream timing(reply.substr(timingSplit + 1));
+      timing >> result.timing.bytes >> result.timing.rows >> result.timing.seconds >> result.timing.memoryGrowth;
+    }
+    return result;
   }
-  sink.resetStringStream();
+  result.failed = true;
+  if(outcome == ProcessPool::TimedOut) {
+    result.fields = "timeout," + reply;
+    result.console = "Worker timed out, " + reply;
+  } else {
+    result.fields = "crash," + reply;
+    result.console = "Worker crashed, " + reply;
+  }
+  return result;
+}
+
+/** Run a tier of checks on the files at the given indices, either on the
+ *  thread pool or in the worker processes, and hand each result to report
+ *  on this thread, in input order unless unordered is set. */
+template <typename Report> void runChecks(WorkerPool *pool, ProcessPool *processes, VerdictCache *cache,
+  CheckTier tier, bool fastParser, const std::vector<std::string> &lines, const std::vector<std::size_t> &indices,
+  bool unordered, Report report)
+{
+  if(processes) {
+    // Results come back on this thread, so they only need putting in order
+    std::map<std::size_t, TestResult> waiting;
+    std::size_t nextReport = 0;
+    auto deliver = [&](std::size_t n, const TestResult &result) {
+      if(unordered) {
+        report(indices[n], result);
+        return;
+      }
+      waiting[n] = result;
+      for(auto found=waiting.find(nextReport);found!=waiting.end();found=waiting.find(nextReport)) {
+        report(indices[nextReport++], found->second);
+        waiting.erase(found);
+      }
+    };
+
+    // Only one copy of each content goes to a worker, the others get its
+    // verdict. The files are hashed in the workers as well, so that reading
+    // them is spread out and a crash while reading one is isolated too.
+    std::vector<std::size_t> sent;
+    std::vector<std::vector<std::size_t> > copies;
+    if(cache) {
+      std::vector<std::string> hashRequests;
+      std::vector<std::size_t> hashed;
+      for(std::size_t n=0;n<indices.size();n++) {
+        ContentKey key;
+        if(!cache->contentKey(lines[indices[n]], key, false)) {
+          hashRequests.push_back("#" + lines[indices[n]]);
+          hashed.push_back(n);
+        }
+      }
+      processes->run(hashRequests, [&](std::size_t k, ProcessPool::Outcome outcome, const std::string &reply) {
+        std::size_t space = reply.find(' ');
+        if(outcome == ProcessPool::Completed && space != std::string::npos) {
+          ContentKey key = makeContentKey(lines[indices[hashed[k]]], std::strtoull(reply.c_str(), nullptr, 16),
+            std::strtoull(reply.c_str() + space + 1, nullptr, 10));
+          cache->setContentKey(lines[indices[hashed[k]]], key);
+        }
+      });
+      std::map<ContentKey, std::size_t> firstCopy;
+      for(std::size_t n=0;n<indices.size();n++) {
+        ContentKey key;
+        if(cache->contentKey(lines[indices[n]], key, false)) {
+          auto found = firstCopy.find(key);
+          if(found != firstCopy.end()) {
+            copies[found->second].push_back(n);
+            cache->countHit();
+            continue;
+          }
+          firstCopy[key] = sent.size();
+          cache->countMiss();
+        }
+        sent.push_back(n);
+        copies.push_back(std::vector<std::size_t>());
+      }
+    } else {
+      for(std::size_t n=0;n<indices.size();n++) {
+        sent.push_back(n);
+      }
+      copies.resize(sent.size());
+    }
+
+    std::vector<std::string> requests;
+    for(std::size_t n : sent) {
+      requests.push_back((char)tier + lines[indices[n]]);
+    }
+    processes->run(requests, [&](std::size_t k, ProcessPool::Outcome outcome, const std::string &reply) {
+      TestResult result = workerResult(outcome, reply);
+      deliver(sent[k], result);
+      for(std::size_t n : copies[k]) {
+        deliver(n, sharedResult(result));
+      }
+    });
+    return;
+  }
+  if(unordered) {
+    BoundedQueue<std::pair<std::size_t, TestResult> > done;
+    for(std::size_t i : indices) {
+      pool->post([&done,&lines,cache,tier,fastParser,i]() {
+        done.push(std::make_pair(i, runCheck(cache, tier, lines[i], fastParser)));
+      });
+    }
+    std::pair<std::size_t, TestResult> item;
+    for(std::size_t n=0;n<indices.size() && done.pop(item);n++) {
+      report(item.first, item.second);
+    }
+  } else {
+    OrderedResults<TestResult> results(indices.size());
+    for(std::size_t n=0;n<indices.size();n++) {
+      std::size_t i = indices[n];
+      pool->post([&results,&lines,cache,tier,fastParser,n,i]() {
+        results.set(n, runCheck(cache, tier, lines[i], fastParser));
+      });
+    }
+    results.drain([&](std::size_t n, const TestResult &result) {
+      report(indices[n], result);
+    });
+  }
+  pool->wait();
+}
+
+/** What to do with a file that has been found. */
+enum FoundAction { IgnoreFile, PassFile, CheckFile };
+
+/** A file found by a walk, with the result of checking it if it was. */
+struct FoundFile
+{
+  FoundFile() : checked(false)
+  {}
+  std::string path;
+  bool checked;
+  TestResult result;
+};
+
+/** Walk the inputs on a thread of its own, checking each file on the pool
+ *  as soon as it is found, and hand the files to report on this thread, in
+ *  the order they were found unless unordered is set. walk(found) calls
+ *  found with each path and classify says what to do with it. */
+template <typename Walk, typename Classify, typename Report> void streamChecks(WorkerPool &pool,
+  VerdictCache *cache, CheckTier tier, bool fastParser, Walk walk, Classify classify, bool unordered, Report report)
+{
+  OrderedResults<FoundFile> results;
+  BoundedQueue<FoundFile> done;
+  std::thread walker([&]() {
+    walk([&](const std::string &path) {
+      FoundAction action = classify(path);
+      if(action == IgnoreFile) {
+        return true;
+      }
+      FoundFile file;
+      file.path = path;
+      if(unordered) {
+        if(action == PassFile) {
+          done.push(file);
+          return true;
+        }
+        pool.post([&done,cache,tier,fastParser,file]() mutable {
+          file.checked = true;
+          file.result = runCheck(cache, tier, file.path, fastParser);
+          done.push(file);
+        });
+        return true;
+      }
+      std::size_t n = results.reserve();
+      if(action == PassFile) {
+        results.set(n, file);
+        return true;
+      }
+      pool.post([&results,cache,tier,fastParser,file,n]() mutable {
+        file.checked = true;
+        file.result = runCheck(cache, tier, file.path, fastParser);
+        results.set(n, file);
+      });
+      return true;
+    });
+    // Every file has been handed out, the results end once they are all in
+    if(unordered) {
+      pool.wait();
+      done.close();
+    } else {
+      results.close();
+    }
+  });
+  if(unordered) {
+    FoundFile file;
+    while(done.pop(file)) {
+      report(file);
+    }
+  } else {
+    results.drain([&](std::size_t, const FoundFile &file) {
+      report(file);
+    });
+  }
+  walker.join();
+  pool.wait();
+}
+
+/** Write the CSV row for a failure, the tier column is only there when the
+ *  files were triaged. */
+void writeFailureRow(QTextStream &csv, const JournalEntry &entry)
+{
+  csv << QString::fromStdString(entry.path);
+  if(!entry.tier.empty()) {
+    csv << "," << QString::fromStdString(entry.tier);
+  }
+  csv << "," << QString::fromStdString(entry.fields) << endl;
+}
+
+/** Parse a shard given as i/N, numbered from 1. */
+bool parseShard(const std::string &text, unsigned &index, unsigned &count)
+{
+  std::size_t slash = text.find('/');
+  if(slash == std::string::npos) {
+    return false;
+  }
+  char *end;
+  index = (unsigned)std::strtoul(text.c_str(), &end, 10);
+  if(end != text.c_str() + slash) {
+    return false;
+  }
+  count = (unsigned)std::strtoul(text.c_str() + slash + 1, &end, 10);
+  return !*end && slash + 1 < text.size() && count && index >= 1 && index <= count;
+}
+
+/** Shard, from 0, that a path falls in when sharding by hash. The hash is of
+ *  the path as given, so every node has to be given the inputs the same way. */
+unsigned hashShard(const std::string &path, unsigned count)
+{
+  ContentHash hasher;
+  hasher.update(path);
+  return (unsigned)(hasher.digest() % count);
+}
+
+/** The paths in shard index (from 0) of count when sharding by size: largest
+ *  first, each path goes in the shard with the fewest bytes so far, ties going
+ *  to the lower path and the lower shard, so every node comes to the same
+ *  split without talking to the others. */
+std::set<std::string> sizeShard(const std::vector<std::string> &paths, unsigned index, unsigned count)
+{
+  std::vector<std::pair<boost::uint64_t, std::string> > sized;
+  for(const std::string &path : paths) {
+    sized.push_back(std::make_pair(inputSize(path), path));
+  }
+  std::sort(sized.begin(), sized.end(), [](const std::pair<boost::uint64_t, std::string> &a,
+    const std::pair<boost::uint64_t, std::string> &b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+  });
+  std::vector<boost::uint64_t> totals(count, 0);
+  std::set<std::string> mine;
+  for(const auto &item : sized) {
+    unsigned lightest = (unsigned)(std::min_element(totals.begin(), totals.end()) - totals.begin());
+    totals[lightest] += item.first;
+    if(lightest == index) {
+      mine.insert(item.second);
+    }
+  }
+  return mine;
+}
+
+/** Take the shard=i/N option of a sharded run out of its journal options. */
+std::string splitShardOption(const std::string &options, std::string &shard)
+{
+  std::vector<std::string> words;
+  boost::algorithm::split(words, options, boost::algorithm::is_any_of(" "));
+  std::string rest;
+  shard.clear();
+  for(const std::string &word : words) {
+    if(boost::algorithm::starts_with(word, "shard=")) {
+      shard = word.substr(6);
+    } else {
+      rest += (rest.empty() ? "" : " ") + word;
+    }
+  }
+  return rest;
+}
+
+/** Combine the verdicts in several journals into one report. A later verdict
+ *  for the same file and tier replaces an earlier one. Journals of the shards
+ *  of a run, which all have to be there, give a report ordered by path with
+ *  the counts of each shard. An output CSV stands for its journal. */
+int mergeJournals(const std::vector<std::string> &journalArgs, const std::string &outputPathString)
+{
+  std::vector<std::string> journalPaths;
+  for(const std::string &arg : journalArgs) {
+    if(!boost::algorithm::ends_with(arg, ".journal") && boost::filesystem::exists(openstudio::toPath(arg + ".journal"))) {
+      journalPaths.push_back(arg + ".journal");
+    } else {
+      journalPaths.push_back(arg);
+    }
+  }
+  std::vector<JournalEntry> merged;
+  std::vector<std::string> entryShards;
+  std::map<std::pair<std::string, std::string>, std::size_t> positions;
+  std::string mergedOptions;
+  std::set<std::string> shards;
+  for(std::size_t i=0;i<journalPaths.size();i++) {
+    const std::string &journalPath = journalPaths[i];
+    std::vector<JournalEntry> entries;
+    std::string options;
+    std::string message;
+    if(!readJournal(openstudio::toPath(journalPath), entries, options, message)) {
+      std::cout << message << std::endl;
+      return EXIT_FAILURE;
+    }
+    // Shards differ only in which shard they are
+    std::string shard;
+    options = splitShardOption(options, shard);
+    if(!i) {
+      mergedOptions = options;
+    } else if(options != mergedOptions) {
+      std::cout << "Journal '" << journalPath << "' was written with different options (" << options
+        << ") than '" << journalPaths.front() << "' (" << mergedOptions << ")" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if(!shard.empty()) {
+      shards.insert(shard);
+    }
+    for(const JournalEntry &entry : entries) {
+      std::pair<std::string, std::string> key(entry.path, entry.tier);
+      auto found = positions.find(key);
+      if(found == positions.end()) {
+        positions[key] = merged.size();
+        merged.push_back(entry);
+        entryShards.push_back(shard);
+      } else {
+        merged[found->second] = entry;
+        entryShards[found->second] = shard;
+      }
+    }
+  }
+
+  // Every shard of the run has to be there for the report to be complete
+  unsigned shardCount = 0;
+  for(const std::string &shard : shards) {
+    unsigned index, count;
+    parseShard(shard, index, count);
+    if(shardCount && count != shardCount) {
+      std::cout << "Journals are from runs split into " << shardCount << " and " << count << " shards" << std::endl;
+      return EXIT_FAILURE;
+    }
+    shardCount = count;
+  }
+  std::vector<std::size_t> order(merged.size());
+  for(std::size_t n=0;n<order.size();n++) {
+    order[n] = n;
+  }
+  if(!shards.empty()) {
+    std::stable_sort(order.begin(), order.end(), [&merged](std::size_t a, std::size_t b) {
+      return merged[a].path < merged[b].path;
+    });
+  }
+
+  QFile outfile(QString().fromStdString(outputPathString));
+  if (!outfile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    std::cout << "Failed to open output file '" << outputPathString << "'" << std::endl;
+    return EXIT_FAILURE;
+  }
+  QTextStream csv(&outfile);
+  std::set<std::string> files;
+  std::set<std::string> failedFiles;
+  std::map<std::string, std::set<std::string> > shardFiles;
+  std::map<std::string, std::set<std::string> > shardFailures;
+  unsigned headerFailures = 0;
+  unsigned dataFailures = 0;
+  for(std::size_t n : order) {
+    const JournalEntry &entry = merged[n];
+    files.insert(entry.path);
+    shardFiles[entryShards[n]].insert(entry.path);
+    if(entry.failed) {
+      failedFiles.insert(entry.path);
+      shardFailures[entryShards[n]].insert(entry.path);
+      if(entry.tier == "header") {
+        ++headerFailures;
+      } else {
+        ++dataFailures;
+      }
+      writeFailureRow(csv, entry);
+    }
+  }
+  outfile.close();
+  std::cout << "Merged " << journalPaths.size() << " journals: " << files.size() << " files, "
+    << files.size() - failedFiles.size() << " passed, " << failedFiles.size() << " failed";
+  if(headerFailures) {
+    std::cout << " (" << headerFailures << " at the header, " << dataFailures << " in the data)";
+  }
+  std::cout << std::endl;
+  std::string missing;
+  for(unsigned n=1;n<=shardCount;n++) {
+    std::string shard = std::to_string(n) + "/" + std::to_string(shardCount);
+    if(shards.count(shard)) {
+      std::cout << "Shard " << shard << ": " << shardFiles[shard].size() << " files, "
+        << shardFailures[shard].size() << " failed" << std::endl;
+    } else {
+      missing += " " + shard;
+    }
+  }
+  if(!missing.empty()) {
+    std::cout << "Missing shards:" << missing << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
 }
 
 int main(int argc, char *argv[])
 {
-  std::string inputPathString;
+  std::vector<std::string> inputPathStrings;
   std::string outputPathString;
+  std::string parserString = "epwfile";
+  std::string journalPathString;
+  std::vector<std::string> mergePathStrings;
+  std::string shardString;
+  std::string reportPathString;
+  std::string reportFormat;
+  std::string shardByString = "hash";
+  unsigned jobs = 1;
+  unsigned processCount = 0;
+  double timeout = 120;
   boost::program_options::options_description desc("Allowed options");
 
   desc.add_options()
     ("help,h", "print help message")
-    ("input-path,i", boost::program_options::value<std::string>(&inputPathString), "path to input txt file")
+    ("input-path,i", boost::program_options::value<std::vector<std::string> >(&inputPathStrings),
+      "path to input txt file with one EPW path per line, a directory to search for EPW files, or a zip or tar"
+      " archive whose EPW members are checked without extracting them (failures are named archive!member);"
+      " may be repeated")
     ("output-path,o", boost::program_options::value<std::string>(&outputPathString), "path to output csv file")
+    ("parser,p", boost::program_options::value<std::string>(&parserString),
+      "EPW parser to use: epwfile (OpenStudio's EpwFile, the default) or fast (memory mapped, structural checks only);"
+      " compressed files (.epw.gz, .epw.zst) and archive members are always checked with fast")
+    ("jobs,j", boost::program_options::value<unsigned>(&jobs), "number of files to check at once, 0 for one per hardware thread (default 1)")
+    ("processes,P", boost::program_options::value<unsigned>(&processCount),
+      "check files in this many worker processes rather than threads, 0 for one per hardware thread;"
+      " a worker that crashes or hangs is replaced and the file it was checking is reported as a crash or timeout")
+    ("timeout", boost::program_options::value<double>(&timeout),
+      "with --processes, seconds a worker may spend on one file before it is killed, 0 for no limit (default 120)")
+    ("dedup", "check each distinct file content once and give its verdict to every copy, found by hashing the files")
+    ("unordered", "write failures as soon as they are found rather than in input order")
+    ("triage,t", "check every file's header and size first and only fully check the files that pass;"
+      " the CSV gains a column after the path naming the tier, header or data, that rejected the file")
+    ("check-all", "with --triage, fully check the files rejected by the header check as well")
+    ("journal,J", boost::program_options::value<std::string>(&journalPathString),
+      "record every verdict in a journal that is synced to disk as the run goes")
+    ("resume", "skip the files that already have a verdict in the journal and add to it"
+      " (the journal defaults to the output path plus .journal)")
+    ("shard", boost::program_options::value<std::string>(&shardString),
+      "check only shard i of N, numbered from 1 (e.g. 2/8); nodes given the same inputs and N check disjoint"
+      " shards without talking to each other, and each keeps a journal (by default the output path plus .journal)"
+      " for --merge")
+    ("shard-by", boost::program_options::value<std::string>(&shardByString),
+      "how --shard splits the files: hash (of the path, the default) or size (bins of about equal bytes,"
+      " which means finding and sizing every file first)")
+    ("merge", boost::program_options::value<std::vector<std::string> >(&mergePathStrings)->multitoken(),
+      "write one report from the journals (or the output CSVs, standing for their journals) of several runs"
+      " instead of checking files; the journals of the shards of a run give a report ordered by path")
+    ("report", boost::program_options::value<std::string>(&reportPathString),
+      "write a row for every file checked, passing or failing, with its bytes, data rows, check time and growth in"
+      " peak memory, ending with a summary of files/s, MB/s and p50/p95/p99 check times")
+    ("report-format", boost::program_options::value<std::string>(&reportFormat),
+      "format of the report: csv or jsonl (JSON Lines), by default jsonl if the report path ends in .jsonl and csv otherwise")
     ("quiet,q", "suppress progress output");
 
   boost::program_options::positional_options_description pos;
@@ -77,20 +922,63 @@ int main(int argc, char *argv[])
     return EXIT_SUCCESS;
   }
 
+  if(outputPathString.empty()) {
+    outputPathString = "epwfailures.csv";
+  }
+
+  if(!mergePathStrings.empty()) {
+    return mergeJournals(mergePathStrings, outputPathString);
+  }
+
   if(!vm.count("input-path")) {
     std::cout << "No input path given." << std::endl << std::endl;
     usage(desc);
     return EXIT_FAILURE;
   }
 
-  // Try to set up a log sink
-  openstudio::StringStreamLogSink sink;
-  sink.setChannelRegex(boost::regex("openstudio\\.EpwFile"));
+  if(parserString != "epwfile" && parserString != "fast") {
+    std::cout << "Unknown parser '" << parserString << "', expected epwfile or fast." << std::endl;
+    return EXIT_FAILURE;
+  }
+  bool fastParser = parserString == "fast";
 
-  // Open the output text file, expect one EPW file per line
-  if(outputPathString.empty()) {
-    outputPathString = "epwfailures.csv";
+  bool triage = vm.count("triage") > 0;
+  bool checkAll = vm.count("check-all") > 0;
+  bool resume = vm.count("resume") > 0;
+  unsigned shardIndex = 0;
+  unsigned shardCount = 0;
+  if(!shardString.empty() && !parseShard(shardString, shardIndex, shardCount)) {
+    std::cout << "Invalid shard '" << shardString << "', expected i/N with i from 1 to N." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(shardByString != "hash" && shardByString != "size") {
+    std::cout << "Unknown shard split '" << shardByString << "', expected hash or size." << std::endl;
+    return EXIT_FAILURE;
   }
+  // The shards are brought together from their journals
+  if((resume || shardCount) && journalPathString.empty()) {
+    journalPathString = outputPathString + ".journal";
+  }
+
+  // A resumed run has to be checking the same way as the run it continues
+  ValidationJournal journal;
+  bool journaling = !journalPathString.empty();
+  if(journaling) {
+    std::string options = "parser=" + parserString + " triage=" + (triage ? "1" : "0")
+      + " check-all=" + (checkAll ? "1" : "0");
+    if(shardCount) {
+      options += " shard=" + shardString + " shard-by=" + shardByString;
+    }
+    std::string message;
+    bool opened = resume ? journal.resume(openstudio::toPath(journalPathString), options, message)
+      : journal.create(openstudio::toPath(journalPathString), options, message);
+    if(!opened) {
+      std::cout << message << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Open the output text file, the report is rewritten in full on every run
   QFile outfile(QString().fromStdString(outputPathString));
   
   if (!outfile.open(QIODevice::WriteOnly | QIODevice::Text)) {
@@ -100,41 +988,280 @@ int main(int argc, char *argv[])
 
   QTextStream csv(&outfile);
 
-  // Open the input text file, expect one EPW file per line
-  QFile file(QString().fromStdString(inputPathString));
-  
-  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-    std::cout << "Failed to open input file '" << inputPathString << "'" << std::endl;
-    return EXIT_FAILURE;
+  std::unique_ptr<CheckReport> timingReport;
+  if(!reportPathString.empty()) {
+    if(reportFormat.empty()) {
+      reportFormat = boost::algorithm::iends_with(reportPathString, ".jsonl") ? "jsonl" : "csv";
+    }
+    if(reportFormat != "csv" && reportFormat != "jsonl") {
+      std::cout << "Unknown report format '" << reportFormat << "', expected csv or jsonl." << std::endl;
+      return EXIT_FAILURE;
+    }
+    timingReport.reset(new CheckReport);
+    std::string message;
+    if(!timingReport->open(openstudio::toPath(reportPathString), reportFormat == "jsonl", message)) {
+      std::cout << message << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+
+  // Inputs are text files with one EPW path per line, directories that are
+  // walked for EPW files, or archives. Archives, given directly, listed or
+  // found by a walk, are read for their EPW members.
+  std::vector<std::string> listed;
+  std::vector<openstudio::path> roots;
+  for(const std::string &inputPathString : inputPathStrings) {
+    if(boost::filesystem::is_directory(openstudio::toPath(inputPathString))) {
+      roots.push_back(openstudio::toPath(inputPathString));
+      continue;
+    }
+    if(isArchivePath(openstudio::toPath(inputPathString))) {
+      listed.push_back(inputPathString);
+      continue;
+    }
+    QFile file(QString().fromStdString(inputPathString));
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+      std::cout << "Failed to open input file '" << inputPathString << "'" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    QTextStream in(&file);
+    QString line = in.readLine();
+    while (!line.isNull()) {
+      listed.push_back(line.toStdString());
+      line = in.readLine();
+    }
+  }
+
+  bool quiet = vm.count("quiet") > 0;
+  bool unordered = vm.count("unordered") > 0;
+  if(!jobs) {
+    jobs = WorkerPool::hardwareThreads();
+  }
+  bool expanding = !roots.empty();
+  for(const std::string &path : listed) {
+    expanding = expanding || isArchivePath(openstudio::toPath(path));
+  }
+  if(!expanding) {
+    jobs = (unsigned)std::max<std::size_t>(1, std::min<std::size_t>(jobs, listed.size()));
+  }
+
+  // Files with a verdict from an earlier run are reported from the journal
+  std::set<std::string> headerChecked;
+  std::set<std::string> dataChecked;
+  for(const JournalEntry &entry : journal.entries()) {
+    (entry.tier == "header" ? headerChecked : dataChecked).insert(entry.path);
+    if(entry.failed) {
+      writeFailureRow(csv, entry);
+    }
+  }
+  if(resume && !quiet) {
+    std::cout << "Resuming with " << journal.entries().size() << " verdicts from " << journalPathString << std::endl;
+  }
+
+  // The files to check, in the order they were found
+  std::vector<std::string> lines;
+  std::vector<std::string> walkFailures;
+  auto walk = [&](const std::function<bool(const std::string &path)> &found) {
+    auto expand = [&](const std::string &path) {
+      if(!isArchivePath(openstudio::toPath(path))) {
+        return found(path);
+      }
+      bool more = true;
+      std::string message;
+      if(!walkArchive(openstudio::toPath(path), ".epw", [&](const std::string &reference) {
+          more = found(reference);
+          return more;
+        }, message)) {
+        walkFailures.push_back(message);
+      }
+      return more;
+    };
+    for(const std::string &path : listed) {
+      if(!expand(path)) {
+        return;
+      }
+    }
+    std::vector<std::string> extensions = {".epw", ".zip", ".tar", ".tgz", ".tzst"};
+    for(const openstudio::path &root : roots) {
+      std::string message;
+      if(!walkDirectory(root, extensions, [&expand](const openstudio::path &path) {
+          return expand(openstudio::toString(path));
+        }, message)) {
+        walkFailures.push_back(message);
+      }
+    }
+  };
+  // Sharding by size needs every file and its size before any is checked,
+  // sharding by hash can decide file by file
+  std::set<std::string> shardPaths;
+  if(shardCount && shardByString == "size") {
+    std::vector<std::string> paths;
+    walk([&paths](const std::string &path) {
+      paths.push_back(path);
+      return true;
+    });
+    shardPaths = sizeShard(paths, shardIndex - 1, shardCount);
+    // The walk is made again to check the files, it reports any failures
+    walkFailures.clear();
   }
+  CheckTier firstTier = triage ? HeaderTier : DataTier;
+  auto classify = [&](const std::string &path) {
+    if(shardCount && (shardByString == "size" ? !shardPaths.count(path)
+      : hashShard(path, shardCount) != shardIndex - 1)) {
+      return IgnoreFile;
+    }
+    if(dataChecked.count(path)) {
+      return IgnoreFile;
+    }
+    if(triage && headerChecked.count(path)) {
+      return PassFile;
+    }
+    return CheckFile;
+  };
 
-  QTextStream in(&file);
-  QString line = in.readLine();
-  while (!line.isNull()) {
-    openstudio::path epwPath = openstudio::toPath(line);
-    std::cout << line.toStdString() << std::endl;
-    boost::optional<openstudio::EpwFile> epwFile;
-    try {
-      epwFile = openstudio::EpwFile(epwPath,true);
-      if(!epwFile) {
-        csv << line << ",returned";
-        mineSink(csv,sink);
-        csv << endl;
-        std::cout << "Failed to read " << line.toStdString() << std::endl;
-      }
-    } catch(openstudio::Exception &e) {
-      csv << line << "," << e.message();
-      mineSink(csv,sink);
-      csv << endl;
-      std::cout << e.message() << std::endl;
-    } catch(...) {
-      csv << line << ",exception";
-      mineSink(csv,sink);
-      csv << endl;
-      std::cout << "Caught exception..." << std::endl;
-    }
-    line = in.readLine();
+  // Everything is written from this thread, the workers only hand back results
+  bool journalFailed = false;
+  auto recordTiming = [&](std::size_t i, const char *tier, const TestResult &result) {
+    if(timingReport) {
+      CheckTiming timing = result.timing;
+      timing.path = lines[i];
+      timing.tier = tier;
+      timing.failed = result.failed;
+      timingReport->add(timing);
+    }
+  };
+  auto recordVerdict = [&](std::size_t i, const char *tier, const TestResult &result) {
+    JournalEntry entry;
+    entry.path = lines[i];
+    entry.tier = triage ? tier : "";
+    entry.failed = result.failed;
+    entry.fields = result.fields;
+    if(result.failed) {
+      writeFailureRow(csv, entry);
+      std::cout << result.console << std::endl;
+    }
+    recordTiming(i, tier, result);
+    std::string message;
+    if(journaling && !journalFailed && !journal.record(entry, message)) {
+      std::cout << message << std::endl;
+      journalFailed = true;
+    }
+  };
+  auto reportData = [&](std::size_t i, const TestResult &result) {
+    if(!quiet) {
+      std::cout << lines[i] << std::endl;
+    }
+    if(result.failed) {
+      if(quiet) {
+        std::cout << lines[i] << std::endl;
+      }
+    }
+    recordVerdict(i, "data", result);
+  };
+  // With triage the files that pass the header check, or all of them with
+  // --check-all, go on to the data check once every header has been checked
+  std::vector<std::size_t> remaining;
+  auto reportFirstTier = [&](std::size_t i, bool checked, const TestResult &result) {
+    if(!checked) {
+      if(checkAll) {
+        remaining.push_back(i);
+      }
+    } else if(triage) {
+      if(result.failed) {
+        std::cout << lines[i] << std::endl;
+        recordVerdict(i, "header", result);
+      } else {
+        // Passing the header is not a verdict, but it was a check
+        recordTiming(i, "header", result);
+      }
+      if(!result.failed || checkAll) {
+        remaining.push_back(i);
+      }
+    } else {
+      reportData(i, result);
+    }
+  };
+
+  std::unique_ptr<VerdictCache> cache;
+  if(vm.count("dedup")) {
+    cache.reset(new VerdictCache);
+  }
+  std::unique_ptr<ProcessPool> processes;
+  std::unique_ptr<WorkerPool> pool;
+  if(vm.count("processes")) {
+    // Worker processes are forked before any thread is started, the workers
+    // would inherit locks held by the other threads otherwise, so the walk
+    // has to be finished first
+    std::vector<std::size_t> firstChecks;
+    walk([&](const std::string &path) {
+      FoundAction action = classify(path);
+      if(action != IgnoreFile) {
+        lines.push_back(path);
+        if(action == CheckFile) {
+          firstChecks.push_back(lines.size() - 1);
+        } else {
+          reportFirstTier(lines.size() - 1, false, TestResult());
+        }
+      }
+      return true;
+    });
+    if(!processCount) {
+      processCount = WorkerPool::hardwareThreads();
+    }
+    processCount = (unsigned)std::max<std::size_t>(1, std::min<std::size_t>(processCount, firstChecks.size()));
+    processes.reset(new ProcessPool(processCount, [fastParser](const std::string &request) {
+      return checkInWorker(request, fastParser);
+    }, timeout));
+    std::string message;
+    if(!processes->start(message)) {
+      std::cout << message << std::endl;
+      return EXIT_FAILURE;
+    }
+    runChecks(pool.get(), processes.get(), cache.get(), firstTier, fastParser, lines, firstChecks, unordered,
+      [&](std::size_t i, const TestResult &result) {
+      reportFirstTier(i, true, result);
+    });
+  } else {
+    // Files are checked as the walk finds them, so listing a large tree
+    // overlaps with checking it
+    pool.reset(new WorkerPool(jobs, 4*jobs));
+    streamChecks(*pool, cache.get(), firstTier, fastParser, walk, classify, unordered, [&](const FoundFile &file) {
+      lines.push_back(file.path);
+      reportFirstTier(lines.size() - 1, file.checked, file.result);
+    });
+  }
+
+  if(triage) {
+    std::sort(remaining.begin(), remaining.end());
+    runChecks(pool.get(), processes.get(), cache.get(), DataTier, fastParser, lines, remaining, unordered, reportData);
+  }
+  if(cache) {
+    std::cout << "Content dedup: " << cache->hits() << " checks answered by an identical file (hits), "
+      << cache->misses() << " checks run (misses)" << std::endl;
+  }
+  for(const std::string &message : walkFailures) {
+    std::cout << message << std::endl;
   }
   outfile.close();
-  return EXIT_SUCCESS;
+  bool reportFailed = false;
+  if(timingReport) {
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    std::cout << timingReport->summaryText(wall);
+    std::string message;
+    if(!timingReport->finish(wall, message)) {
+      std::cout << message << std::endl;
+      reportFailed = true;
+    }
+  }
+  if(journaling) {
+    std::string message;
+    if(!journal.checkpoint(message)) {
+      std::cout << message << std::endl;
+      journalFailed = true;
+    }
+  }
+  return journalFailed || reportFailed || !walkFailures.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
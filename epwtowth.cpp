@@ -18,6 +18,7 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  **********************************************************************/
 
+#include <OpenStudio.hxx>
 #include <model/Model.hpp>
 #include <osversion/VersionTranslator.hpp>
 #include <utilities/core/CommandLine.hpp>
@@ -25,26 +26,693 @@
 #include <utilities/sql/SqlFile.hpp>
 #include <utilities/filetypes/EpwFile.hpp>
 
+#include "ArchiveReader.hpp"
+#include "ContentHash.hpp"
+#include "EpwCache.hpp"
+#include "EpwCsvWriter.hpp"
+#include "EpwIndex.hpp"
+#include "EpwReader.hpp"
+#include "InputList.hpp"
+#include "OutputStamp.hpp"
+#include "Profile.hpp"
+#include "RecordFanOut.hpp"
+#include "StreamIO.hpp"
+#include "WorkerPool.hpp"
+#include "WthStreamTranslator.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
 #include <string>
 #include <iostream>
+#include <vector>
+
+// Bump this whenever a change alters what epwtowth writes, so that incremental
+// runs regenerate their outputs
+static const char *EPWTOWTH_VERSION = "1.1";
 
 void usage( boost::program_options::options_description desc)
 {
   std::cout << "Usage: epwtowth --input-path=./path/to/input.epw" << std::endl;
   std::cout << "   or: epwtowth input.epw" << std::endl;
+  std::cout << "   or: epwtowth --jobs=8 first.epw second.epw @more.txt ./library/*.epw" << std::endl;
+  std::cout << "   or: epwtowth --to-cache input.epw" << std::endl;
+  std::cout << "   or: epwtowth --from-cache input.epw" << std::endl;
+  std::cout << "   or: epwtowth input.epw.gz" << std::endl;
+  std::cout << "   or: epwtowth weather.zip" << std::endl;
+  std::cout << "   or: gunzip -c input.epw.gz | epwtowth - > output.wth" << std::endl;
+  std::cout << "   or: epwtowth --start=7/14 --end=7/20 input.epw" << std::endl;
+  std::cout << "   or: epwtowth --parser=fast --emit=wth,csv,columnar input.epw" << std::endl;
   std::cout << desc << std::endl;
 }
 
+// Standard input and output, read and written through large buffers. They are
+// set up once for the run, only a single conversion can use them.
+struct StandardStreams
+{
+  StandardStreams() : inBuffer(stdin), in(&inBuffer), outBuffer(stdout), out(&outBuffer)
+  {}
+
+  FileInputBuffer inBuffer;
+  std::istream in;
+  FileOutputBuffer outBuffer;
+  std::ostream out;
+};
+
+struct ConversionOptions
+{
+  StandardStreams *standardStreams;
+  bool fastParser;
+  bool streaming;
+  bool toCache;
+  bool fromCache;
+  bool incremental;
+  // Outputs to write from the one parse
+  bool emitWth;
+  bool emitCsv;
+  bool emitColumnar;
+  // Date range to translate, a zero month for the start or end of the data period
+  int startMonth;
+  int startDay;
+  int endMonth;
+  int endDay;
+
+  bool slice() const
+  {
+    return startMonth || endMonth;
+  }
+
+  // The options that affect the output, for incremental runs
+  std::string signature() const
+  {
+    std::string result = std::string("parser=") + (fastParser ? "fast" : "epwfile") + ";streaming=" + (streaming ? "1" : "0")
+      + ";to-cache=" + (toCache ? "1" : "0") + ";from-cache=" + (fromCache ? "1" : "0");
+    if(emitCsv || emitColumnar || !emitWth) {
+      result += std::string(";emit=") + (emitWth ? "wth" : "") + (emitCsv ? "+csv" : "") + (emitColumnar ? "+columnar" : "");
+    }
+    if(slice()) {
+      result += ";start=" + boost::lexical_cast<std::string>(startMonth) + "/" + boost::lexical_cast<std::string>(startDay)
+        + ";end=" + boost::lexical_cast<std::string>(endMonth) + "/" + boost::lexical_cast<std::string>(endDay);
+    }
+    return result;
+  }
+};
+
+struct ConversionResult
+{
+  bool success;
+  bool skipped;
+  std::string message;
+  std::shared_ptr<Profile> profile;
+};
+
+// Size of a file for the profile, zero if it cannot be had
+boost::uint64_t fileBytes(const openstudio::path &path)
+{
+  boost::system::error_code ec;
+  boost::uint64_t size = boost::filesystem::file_size(path, ec);
+  return ec ? 0 : size;
+}
+
+ConversionResult convertToCache(const openstudio::path &inputPath, const openstudio::path &outPath, Profile *profile)
+{
+  ConversionResult result = {false, false, std::string()};
+  profileBegin(profile, "write cache");
+  bool ok = writeEpwCache(inputPath, outPath, result.message);
+  profileEnd(profile);
+  if(profile) {
+    profile->bytesRead = fileBytes(inputPath);
+    profile->bytesWritten = fileBytes(outPath);
+  }
+  if(!ok) {
+    return result;
+  }
+  result.success = true;
+  result.message = "Wrote '" + openstudio::toString(outPath) + "'";
+  return result;
+}
+
+// Open the cache for an input, which may be either the EPW or the cache. The
+// cache is checked against the EPW whenever the EPW is available.
+bool openCache(const openstudio::path &inputPath, EpwCache &cache, openstudio::path &epwPath, std::string &message)
+{
+  openstudio::path cachePath = epwCachePath(inputPath);
+  epwPath = inputPath;
+  if(inputPath.extension() == openstudio::toPath(".epwc")) {
+    cachePath = inputPath;
+    epwPath = openstudio::path(inputPath).replace_extension(openstudio::toPath("epw").string());
+    if(!boost::filesystem::exists(epwPath)) {
+      epwPath = inputPath;
+      return cache.open(cachePath, message);
+    }
+  }
+  bool rebuilt;
+  return openEpwCache(epwPath, cachePath, cache, rebuilt, message);
+}
+
+// True if an input is a member of an archive, archive!member
+bool isArchiveMember(const openstudio::path &inputPath)
+{
+  openstudio::path archive;
+  std::string member;
+  return splitArchiveMember(inputPath.string(), archive, member);
+}
+
+// The WTH for a member of an archive goes in a directory named after the
+// archive, next to it, at the member's path within the archive
+openstudio::path archiveMemberOutputPath(const openstudio::path &inputPath, const std::string &extension)
+{
+  openstudio::path archive;
+  std::string member;
+  splitArchiveMember(inputPath.string(), archive, member);
+  std::string name = archive.filename().string();
+  for(const char *suffix : {".zip", ".tar.gz", ".tar.zst", ".tgz", ".tzst", ".tar"}) {
+    if(boost::algorithm::iends_with(name, suffix)) {
+      name.erase(name.size() - std::strlen(suffix));
+      break;
+    }
+  }
+  openstudio::path outPath = archive.parent_path() / openstudio::toPath(name);
+  // Names that would climb out of that directory are not followed
+  std::vector<std::string> parts;
+  boost::algorithm::split(parts, member, boost::algorithm::is_any_of("/\\"));
+  for(const std::string &part : parts) {
+    if(!part.empty() && part != "." && part != "..") {
+      outPath /= openstudio::toPath(part);
+    }
+  }
+  return outPath.replace_extension(openstudio::toPath(extension).string());
+}
+
+// The EPW that an input stands for, used to describe the WTH
+std::string describeInput(const openstudio::path &inputPath, const ConversionOptions &options)
+{
+  if(isStandardStream(inputPath)) {
+    return "standard input";
+  }
+  if(options.fromCache && inputPath.extension() == openstudio::toPath(".epwc")) {
+    openstudio::path epwPath = openstudio::path(inputPath).replace_extension(openstudio::toPath("epw").string());
+    if(boost::filesystem::exists(epwPath)) {
+      return openstudio::toString(epwPath);
+    }
+  }
+  return openstudio::toString(inputPath);
+}
+
+// Find the date range of an input with its day index
+bool openSlice(const openstudio::path &inputPath, const ConversionOptions &options, MappedFile &mapped,
+  EpwSlice &slice, std::string &message)
+{
+  EpwDayIndex index;
+  return mapped.open(inputPath, message) && openEpwDayIndex(inputPath, mapped, index, message)
+    && sliceEpw(mapped, index, options.startMonth, options.startDay, options.endMonth, options.endDay, slice, message);
+}
+
+// Pass the records of an input to a handler, reading them from the cache, a
+// date range of the mapped file, standard input or the (possibly compressed)
+// file as the options and input call for
+bool parseInput(const openstudio::path &inputPath, const ConversionOptions &options, std::istream &stdinStream,
+  EpwRecordHandler &handler, ContentHash *sourceHash, std::string &message)
+{
+  if(options.fromCache) {
+    EpwCache cache;
+    openstudio::path epwPath;
+    return openCache(inputPath, cache, epwPath, message) && cache.replay(handler, message);
+  }
+  if(options.slice()) {
+    MappedFile mapped;
+    EpwSlice slice;
+    if(!openSlice(inputPath, options, mapped, slice, message)) {
+      return false;
+    }
+    EpwParser parser(handler);
+    if(!parser.begin(slice.header) || !parser.feed(slice.data, slice.size) || !parser.finish()) {
+      message = parser.message();
+      return false;
+    }
+    return true;
+  }
+  if(isStandardStream(inputPath)) {
+    return parseEpwStream(stdinStream, handler, message);
+  }
+  if(isArchiveMember(inputPath)) {
+    ArchiveReader *reader = openArchiveMember(inputPath.string(), message);
+    if(!reader) {
+      return false;
+    }
+    if(!reader->error().empty() || !parseEpwStream(reader->stream(), handler, message)) {
+      if(!reader->error().empty()) {
+        message = reader->error();
+      }
+      return false;
+    }
+    return true;
+  }
+  return parseEpwInput(inputPath, handler, message, sourceHash);
+}
+
+// Parse an input into a handler as parseInput does, timing the header and
+// records phases and the handler's share of them when profiling
+bool parseProfiled(const openstudio::path &inputPath, const ConversionOptions &options, std::istream &stdinStream,
+  EpwRecordHandler &handler, const std::string &handlerName, Profile *profile, ContentHash *sourceHash,
+  std::string &message)
+{
+  if(!profile) {
+    return parseInput(inputPath, options, stdinStream, handler, sourceHash, message);
+  }
+  ProfiledHandler profiled(handler, *profile, handlerName);
+  profile->begin("header");
+  return parseInput(inputPath, options, stdinStream, profiled, sourceHash, message);
+}
+
+// Translate an input with EpwDataPoint a record at a time
+bool translateInput(const openstudio::path &inputPath, const ConversionOptions &options, std::istream &stdinStream,
+  const std::string &description, std::ostream &wth, Profile *profile, std::string &message)
+{
+  WthStreamTranslator translator(description);
+  bool ok;
+  if(options.slice()) {
+    MappedFile mapped;
+    EpwSlice slice;
+    if(!openSlice(inputPath, options, mapped, slice, message)) {
+      return false;
+    }
+    MemoryInputBuffer sliceBuffer(slice.data, slice.size);
+    std::istream records(&sliceBuffer);
+    ok = translator.translate(slice.header, records, wth);
+  } else if(isStandardStream(inputPath)) {
+    ok = translator.translate(stdinStream, wth);
+  } else if(isArchiveMember(inputPath)) {
+    ArchiveReader *reader = openArchiveMember(inputPath.string(), message);
+    if(!reader) {
+      return false;
+    }
+    ok = reader->error().empty() && translator.translate(reader->stream(), wth);
+    if(!ok && !reader->error().empty()) {
+      message = reader->error();
+      return false;
+    }
+  } else {
+    InputFile epw;
+    if(!epw.open(inputPath, message)) {
+      message = "Could not open EPW file '" + openstudio::toString(inputPath) + "'";
+      return false;
+    }
+    ok = translator.translate(epw.stream(), wth);
+    if(!ok && !epw.error().empty()) {
+      message = epw.error();
+      return false;
+    }
+  }
+  if(!ok) {
+    message = translator.message();
+  }
+  if(profile) {
+    profile->rows = translator.records();
+  }
+  return ok;
+}
+
+// Name an output is written under until every output of a conversion is done
+openstudio::path partialPath(const openstudio::path &path)
+{
+  openstudio::path result = path;
+  result += openstudio::toPath(".partial");
+  return result;
+}
+
+// Name an existing output is kept under while its replacement is moved in
+openstudio::path previousPath(const openstudio::path &path)
+{
+  openstudio::path result = path;
+  result += openstudio::toPath(".old");
+  return result;
+}
+
+// Put back the outputs set aside by commitOutputs and drop the partial files
+void rollbackOutputs(const std::vector<openstudio::path> &paths, const std::vector<bool> &setAside,
+  std::size_t moved)
+{
+  boost::system::error_code ec;
+  for(std::size_t i=0;i<paths.size();i++) {
+    if(i < moved) {
+      boost::filesystem::remove(paths[i], ec);
+    } else {
+      boost::filesystem::remove(partialPath(paths[i]), ec);
+    }
+    if(setAside[i]) {
+      boost::filesystem::rename(previousPath(paths[i]), paths[i], ec);
+    }
+  }
+}
+
+// Move finished outputs from their partial names into place, all or none.
+// Existing outputs are set aside first and only deleted once every new one is
+// in place, so a failure leaves the previous set of outputs as it was.
+bool commitOutputs(const std::vector<openstudio::path> &paths, std::string &message)
+{
+  boost::system::error_code ec;
+  std::vector<bool> setAside(paths.size(), false);
+  for(std::size_t i=0;i<paths.size();i++) {
+    if(!boost::filesystem::exists(paths[i], ec)) {
+      continue;
+    }
+    boost::filesystem::rename(paths[i], previousPath(paths[i]), ec);
+    if(ec) {
+      message = "Failed to set aside existing '" + openstudio::toString(paths[i]) + "'";
+      rollbackOutputs(paths, setAside, 0);
+      return false;
+    }
+    setAside[i] = true;
+  }
+  for(std::size_t i=0;i<paths.size();i++) {
+    boost::filesystem::rename(partialPath(paths[i]), paths[i], ec);
+    if(ec) {
+      message = "Failed to move '" + openstudio::toString(paths[i]) + "' into place";
+      rollbackOutputs(paths, setAside, i);
+      return false;
+    }
+  }
+  for(std::size_t i=0;i<paths.size();i++) {
+    if(setAside[i]) {
+      boost::filesystem::remove(previousPath(paths[i]), ec);
+    }
+  }
+  return true;
+}
+
+// An output file written through a large buffer, under its partial name
+struct OutputFile
+{
+  // A file still open here was never finished
+  ~OutputFile()
+  {
+    close(false);
+  }
+
+  bool open(const openstudio::path &filePath, const std::string &kind, std::string &message)
+  {
+    path = filePath;
+    buffer.resize(1 << 20);
+    stream.rdbuf()->pubsetbuf(&buffer[0], buffer.size());
+    stream.open(partialPath(path).string().c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if(!stream) {
+      message = "Could not open " + kind + " file '" + openstudio::toString(path) + "'";
+      return false;
+    }
+    return true;
+  }
+
+  // Close the file, removing it if the conversion failed or the writes did
+  bool close(bool keep)
+  {
+    if(!stream.is_open()) {
+      return true;
+    }
+    stream.close();
+    if(!keep || !stream) {
+      boost::system::error_code ec;
+      boost::filesystem::remove(partialPath(path), ec);
+      return false;
+    }
+    return true;
+  }
+
+  std::vector<char> buffer;
+  std::ofstream stream;
+  openstudio::path path;
+};
+
+// Writes the records out in columns, as an EPW cache, once the parse is complete
+class ColumnarOutput : public EpwCacheWriter
+{
+public:
+  explicit ColumnarOutput(const openstudio::path &path) : m_path(path)
+  {}
+
+  // Hash of the source EPW, filled in by the parse as it reads the file
+  ContentHash *sourceHash()
+  {
+    return &m_hash;
+  }
+
+  // The parse is complete by the time this is called, so the hash is too
+  virtual bool finish(std::string &message)
+  {
+    return write(m_path, m_hash.digest(), m_hash.size(), message);
+  }
+
+private:
+  openstudio::path m_path;
+  ContentHash m_hash;
+};
+
+ConversionResult convertStreaming(const openstudio::path &inputPath, const openstudio::path &outPath,
+  const ConversionOptions &options, Profile *profile)
+{
+  ConversionResult result = {false, false, std::string()};
+  bool toStdout = isStandardStream(outPath);
+  profileBegin(profile, "open");
+
+  StandardStreams &standard = *options.standardStreams;
+  std::istream &stdinStream = standard.in;
+  unsigned long long stdoutStart = standard.outBuffer.bytes();
+
+  OutputFile wthFile;
+  std::ostream *wth = &standard.out;
+  if(options.emitWth && !toStdout) {
+    if(!wthFile.open(outPath, "WTH", result.message)) {
+      return result;
+    }
+    wth = &wthFile.stream;
+  }
+  OutputFile csvFile;
+  if(options.emitCsv && !csvFile.open(openstudio::path(outPath).replace_extension(openstudio::toPath("csv").string()),
+    "CSV", result.message)) {
+    return result;
+  }
+  openstudio::path columnarPath = openstudio::path(outPath).replace_extension(openstudio::toPath("epwc").string());
+
+  std::string description = "Translated from " + describeInput(inputPath, options);
+  bool ok;
+  if(options.emitCsv || options.emitColumnar) {
+    // Parse once and hand the records to every output
+    RecordFanOut fanOut;
+    WthRecordWriter wthWriter(*wth, description);
+    CsvRecordWriter csvWriter(csvFile.stream);
+    ColumnarOutput columnar(partialPath(columnarPath));
+    if(options.emitWth) {
+      fanOut.add(wthWriter, "WTH");
+    }
+    if(options.emitCsv) {
+      fanOut.add(csvWriter, "CSV");
+    }
+    if(options.emitColumnar) {
+      fanOut.add(columnar, "columnar");
+    }
+    ok = parseProfiled(inputPath, options, stdinStream, fanOut, "fan-out", profile,
+      options.emitColumnar ? columnar.sourceHash() : nullptr, result.message);
+  } else if(options.fastParser || options.fromCache) {
+    WthRecordWriter writer(*wth, description);
+    ok = parseProfiled(inputPath, options, stdinStream, writer, "WTH writer", profile, nullptr, result.message);
+  } else {
+    profileBegin(profile, "translate");
+    ok = translateInput(inputPath, options, stdinStream, description, *wth, profile, result.message);
+  }
+  profileBegin(profile, "close");
+
+  // Every output is written under its partial name, and only moved into
+  // place once all of them have been written. Outputs from an earlier run
+  // are kept until the new ones are all in place
+  std::vector<openstudio::path> finished;
+  if(toStdout) {
+    wth->flush();
+    if(ok && !*wth) {
+      ok = false;
+      result.message = "Failed to write WTH output";
+    }
+  }
+  for(OutputFile *file : {&wthFile, &csvFile}) {
+    if(file->stream.is_open()) {
+      if(file->close(ok)) {
+        finished.push_back(file->path);
+      } else if(ok) {
+        ok = false;
+        result.message = "Failed to write '" + openstudio::toString(file->path) + "'";
+      }
+    }
+  }
+  if(options.emitColumnar) {
+    if(ok) {
+      finished.push_back(columnarPath);
+    } else {
+      boost::system::error_code ec;
+      boost::filesystem::remove(partialPath(columnarPath), ec);
+    }
+  }
+  if(!ok) {
+    for(const openstudio::path &path : finished) {
+      boost::system::error_code ec;
+      boost::filesystem::remove(partialPath(path), ec);
+    }
+  } else {
+    ok = commitOutputs(finished, result.message);
+  }
+  profileEnd(profile);
+  if(profile) {
+    if(isStandardStream(inputPath)) {
+      profile->bytesRead = standard.inBuffer.bytes();
+    } else {
+      profile->bytesRead = fileBytes(options.fromCache && inputPath.extension() != openstudio::toPath(".epwc")
+        ? epwCachePath(inputPath) : inputPath);
+    }
+    profile->bytesWritten = standard.outBuffer.bytes() - stdoutStart;
+    if(ok) {
+      for(const openstudio::path &path : finished) {
+        profile->bytesWritten += fileBytes(path);
+      }
+    }
+  }
+  if(!ok) {
+    return result;
+  }
+
+  std::vector<std::string> written;
+  for(const openstudio::path &path : finished) {
+    written.push_back(openstudio::toString(path));
+  }
+
+  if(toStdout) {
+    written.insert(written.begin(), openstudio::toString(outPath));
+  }
+  result.success = true;
+  result.message = "Wrote";
+  for(std::size_t i=0;i<written.size();i++) {
+    result.message += (i ? ", '" : " '") + written[i] + "'";
+  }
+  return result;
+}
+
+ConversionResult convert(const openstudio::path &inputPath, const openstudio::path &outPath, const ConversionOptions &options,
+  Profile *profile)
+{
+  if(options.toCache) {
+    return convertToCache(inputPath, outPath, profile);
+  }
+  // EpwFile needs an uncompressed file on both ends, so standard streams,
+  // compressed inputs and archive members always stream
+  if(options.streaming || options.fastParser || options.fromCache || options.slice() || !options.emitWth
+    || options.emitCsv || options.emitColumnar || isStandardStream(inputPath)
+    || isStandardStream(outPath) || isCompressedPath(inputPath) || isArchiveMember(inputPath)) {
+    return convertStreaming(inputPath, outPath, options, profile);
+  }
+
+  ConversionResult result = {false, false, std::string()};
+
+  // Open the EPW file, storing its data reads and checks every record, so
+  // that is all in the load phase
+  profileBegin(profile, "load (EpwFile)");
+  boost::optional<openstudio::EpwFile> epwFile;
+  try {
+    epwFile = openstudio::EpwFile(inputPath,true);
+    OS_ASSERT(epwFile);
+  }
+  catch(std::exception&) {
+    profileEnd(profile);
+    result.message = "Could not open EPW file '" + openstudio::toString(inputPath) + "'";
+    return result;
+  }
+
+  profileBegin(profile, "write (translateToWth)");
+  bool ok = epwFile->translateToWth(outPath);
+  profileEnd(profile);
+  if(profile) {
+    profile->bytesRead = fileBytes(inputPath);
+    profile->bytesWritten = fileBytes(outPath);
+    profile->rows = epwFile->data().size();
+  }
+  if(!ok) {
+    result.message = "Translation to WTH file failed, check for errors and warnings and try again";
+    return result;
+  }
+
+  result.success = true;
+  result.message = "Wrote '" + openstudio::toString(outPath) + "'";
+  return result;
+}
+
+ConversionResult convertIncremental(const openstudio::path &inputPath, const openstudio::path &outPath,
+  const ConversionOptions &options, Profile *profile)
+{
+  OutputStamp stamp;
+  stamp.version = std::string(EPWTOWTH_VERSION) + "/" + openstudio::openStudioLongVersion();
+  stamp.options = options.signature();
+  std::string message;
+  profileBegin(profile, "check stamp");
+  bool hashed = stamp.hashInput(inputPath, message);
+  bool upToDate = hashed && stamp.upToDate(outPath);
+  profileEnd(profile);
+  if(!hashed) {
+    ConversionResult result = {false, false, message};
+    return result;
+  }
+  if(upToDate) {
+    ConversionResult result = {true, true, "Up to date '" + openstudio::toString(outPath) + "'"};
+    return result;
+  }
+
+  // Remove the old stamp first so that a failed conversion is not taken as up to date
+  boost::system::error_code ec;
+  boost::filesystem::remove(stampPath(outPath), ec);
+  ConversionResult result = convert(inputPath, outPath, options, profile);
+  if(result.success && !stamp.write(outPath, message)) {
+    result.message += " (" + message + ")";
+  }
+  return result;
+}
+
 int main(int argc, char *argv[])
 {
-  std::string inputPathString;
+  std::vector<std::string> inputPathStrings;
   std::string outputPathString;
+  std::string parserString = "epwfile";
+  std::string emitString = "wth";
+  std::string startString;
+  std::string endString;
+  std::string profileFormat = "text";
+  std::string profilePathString;
+  unsigned jobs = 1;
   boost::program_options::options_description desc("Allowed options");
 
   desc.add_options()
     ("help,h", "print help message")
-    ("input-path,i", boost::program_options::value<std::string>(&inputPathString), "path to input EPW file")
-    ("output-path,o", boost::program_options::value<std::string>(&outputPathString), "path to output WTH file")
+    ("input-path,i", boost::program_options::value<std::vector<std::string> >(&inputPathStrings),
+      "path to input EPW file (.epw, .epw.gz or .epw.zst), @file listing EPW files, directory, or wildcard pattern (may be repeated), - for stdin;"
+      " a zip or tar archive stands for its EPW members, which are written to a directory named after the archive")
+    ("output-path,o", boost::program_options::value<std::string>(&outputPathString),
+      "path to output WTH file (single input only), - for stdout")
+    ("jobs,j", boost::program_options::value<unsigned>(&jobs), "number of files to convert at once, 0 for one per processor (default 1)")
+    ("streaming,s", "translate one record at a time instead of loading the whole file")
+    ("parser,p", boost::program_options::value<std::string>(&parserString),
+      "EPW parser to use: epwfile (OpenStudio's EpwFile, the default) or fast (memory mapped, always streams)")
+    ("to-cache", "write a binary EPW cache (.epwc) instead of a WTH file")
+    ("from-cache", "translate from the binary EPW cache, rebuilding it if it is missing or out of date")
+    ("incremental", "skip inputs whose output is up to date with the input, the program version and the options")
+    ("emit", boost::program_options::value<std::string>(&emitString),
+      "outputs to write from a single parse, any of wth, csv and columnar (the .epwc cache) separated by commas (default wth);"
+      " anything beyond wth needs --parser fast")
+    ("profile", "report the time, bytes and rows of each phase of each conversion and the peak memory use")
+    ("profile-format", boost::program_options::value<std::string>(&profileFormat), "profile format: text (the default) or json")
+    ("profile-output", boost::program_options::value<std::string>(&profilePathString),
+      "file to write the profile to instead of the console")
+    ("start", boost::program_options::value<std::string>(&startString), "first day to translate, MM/DD (default the start of the data period)")
+    ("end", boost::program_options::value<std::string>(&endString), "last day to translate, MM/DD (default the end of the data period)")
     ("quiet,q", "suppress progress output");
 
   boost::program_options::positional_options_description pos;
@@ -76,29 +744,250 @@ int main(int argc, char *argv[])
     usage(desc);
     return EXIT_FAILURE;
   }
-  
-  // Open the EPW file
-  openstudio::path inputPath = openstudio::toPath(inputPathString);
 
-  boost::optional<openstudio::EpwFile> epwFile;
-  try {
-    epwFile = openstudio::EpwFile(inputPath,true);
-    OS_ASSERT(epwFile);
+  std::vector<openstudio::path> inputPaths;
+  std::string message;
+  if(!expandInputs(inputPathStrings, ".epw", inputPaths, message)) {
+    std::cout << message << std::endl;
+    return EXIT_FAILURE;
   }
-  catch(std::exception&) {
-    std::cout << "Could not open EPW file '" << inputPathString << "'";
+
+  // Archives stand for their EPW members, which are read without extracting
+  // them
+  std::vector<openstudio::path> expandedPaths;
+  for(const openstudio::path &inputPath : inputPaths) {
+    if(!isArchivePath(inputPath)) {
+      expandedPaths.push_back(inputPath);
+      continue;
+    }
+    if(!walkArchive(inputPath, ".epw", [&expandedPaths](const std::string &reference) {
+        expandedPaths.push_back(openstudio::toPath(reference));
+        return true;
+      }, message)) {
+      std::cout << message << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  inputPaths.swap(expandedPaths);
+
+  if(inputPaths.empty()) {
+    std::cout << "No EPW files found." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if(!outputPathString.empty() && inputPaths.size() > 1) {
+    std::cout << "An output path may only be given with a single input file." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if(parserString != "epwfile" && parserString != "fast") {
+    std::cout << "Unknown parser '" << parserString << "', expected epwfile or fast." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ConversionOptions options;
+  options.fastParser = parserString == "fast";
+  options.streaming = vm.count("streaming") > 0;
+  options.toCache = vm.count("to-cache") > 0;
+  options.fromCache = vm.count("from-cache") > 0;
+  options.incremental = vm.count("incremental") > 0;
+  options.emitWth = options.emitCsv = options.emitColumnar = false;
+  std::vector<std::string> emits;
+  boost::algorithm::split(emits, emitString, boost::algorithm::is_any_of(","));
+  for(std::string emit : emits) {
+    boost::algorithm::trim(emit);
+    if(emit == "wth") {
+      options.emitWth = true;
+    } else if(emit == "csv") {
+      options.emitCsv = true;
+    } else if(emit == "columnar") {
+      options.emitColumnar = true;
+    } else {
+      std::cout << "Unknown output '" << emit << "', expected wth, csv or columnar." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  bool fanOut = options.emitCsv || options.emitColumnar;
+  if(fanOut && !options.fastParser && !options.fromCache) {
+    std::cout << "--emit with csv or columnar hands parsed records to every output, which needs --parser fast." << std::endl;
+    return EXIT_FAILURE;
+  }
+  options.startMonth = options.startDay = options.endMonth = options.endDay = 0;
+  if(!startString.empty() && !parseMonthDay(startString, options.startMonth, options.startDay)) {
+    std::cout << "Invalid start date '" << startString << "', expected MM/DD." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(!endString.empty() && !parseMonthDay(endString, options.endMonth, options.endDay)) {
+    std::cout << "Invalid end date '" << endString << "', expected MM/DD." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(options.toCache && options.fromCache) {
+    std::cout << "Only one of --to-cache and --from-cache may be given." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Standard streams carry a single conversion, and status goes to stderr
+  // whenever the WTH goes to stdout
+  bool fromStdin = std::find_if(inputPaths.begin(), inputPaths.end(), isStandardStream) != inputPaths.end();
+  bool toStdout = outputPathString == "-" || (fromStdin && outputPathString.empty());
+  if(fromStdin && inputPaths.size() > 1) {
+    std::cout << "Standard input may only be used as the only input." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(options.slice() && (fromStdin || options.toCache || options.fromCache
+    || std::find_if(inputPaths.begin(), inputPaths.end(), isCompressedPath) != inputPaths.end())) {
+    std::cout << "--start and --end need uncompressed EPW files and cannot be used with the cache." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(fanOut && (toStdout || options.toCache || options.incremental)) {
+    std::cout << "--emit with csv or columnar cannot be used with standard output, --to-cache or --incremental." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(options.emitColumnar && (fromStdin || options.fromCache || options.slice())) {
+    std::cout << "--emit columnar needs a whole EPW file as input." << std::endl;
+    return EXIT_FAILURE;
+  }
+  bool fromArchive = std::find_if(inputPaths.begin(), inputPaths.end(), isArchiveMember) != inputPaths.end();
+  if(fromArchive && (options.toCache || options.fromCache || options.incremental || options.slice()
+    || options.emitColumnar)) {
+    std::cout << "Members of archives can only be streamed, they cannot be used with --to-cache, --from-cache,"
+      " --incremental, --start, --end or --emit columnar." << std::endl;
     return EXIT_FAILURE;
   }
+  if((fromStdin || toStdout) && (options.toCache || options.fromCache || options.incremental)) {
+    std::cout << "Standard input and output cannot be used with --to-cache, --from-cache or --incremental." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(fromStdin || toStdout) {
+    std::ios_base::sync_with_stdio(false);
+    setBinaryStandardStreams();
+  }
+  StandardStreams standardStreams;
+  options.standardStreams = &standardStreams;
+  std::ostream &report = toStdout ? std::cerr : std::cout;
 
-  openstudio::path outPath = inputPath.replace_extension(openstudio::toPath("wth").string());
-  if(!outputPathString.empty()) {
-    outPath = openstudio::toPath(outputPathString);
+  bool quiet = vm.count("quiet") > 0;
+  bool single = inputPaths.size() == 1;
+  if(!jobs) {
+    jobs = WorkerPool::hardwareThreads();
   }
+  jobs = (unsigned)std::min<std::size_t>(jobs, inputPaths.size());
 
-  if(!epwFile->translateToWth(outPath)) {
-    std::cout << "Translation to WTH file failed, check for errors and warnings and try again" << std::endl;
+  bool profiling = vm.count("profile") > 0;
+  bool profileJson = profileFormat == "json";
+  if(profiling && profileFormat != "text" && !profileJson) {
+    std::cout << "Unknown profile format '" << profileFormat << "', expected text or json." << std::endl;
     return EXIT_FAILURE;
   }
+  std::ofstream profileFile;
+  std::ostream *profileStream = &report;
+  if(!profilePathString.empty()) {
+    profileFile.open(profilePathString.c_str(), std::ios_base::out | std::ios_base::trunc);
+    if(!profileFile) {
+      std::cout << "Failed to open profile output '" << profilePathString << "'" << std::endl;
+      return EXIT_FAILURE;
+    }
+    profileStream = &profileFile;
+  }
+  if(profileJson) {
+    *profileStream << "{\"program\":\"epwtowth " << EPWTOWTH_VERSION << "\",\"openstudio\":\""
+      << jsonEscape(openstudio::openStudioLongVersion()) << "\",\"options\":\"" << jsonEscape(options.signature())
+      << "\",\"files\":[";
+  }
+  std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+
+  // Convert on the pool, the results are reported in input order as they come in
+  OrderedResults<ConversionResult> results(inputPaths.size());
+  WorkerPool pool(jobs);
+  for(std::size_t i=0;i<inputPaths.size();i++) {
+    openstudio::path outPath = stripCompressionExtension(inputPaths[i]);
+    outPath.replace_extension(openstudio::toPath(options.toCache ? "epwc" : "wth").string());
+    if(!outputPathString.empty()) {
+      outPath = openstudio::toPath(outputPathString);
+    } else if(fromStdin) {
+      outPath = openstudio::toPath("-");
+    } else if(isArchiveMember(inputPaths[i])) {
+      outPath = archiveMemberOutputPath(inputPaths[i], "wth");
+      boost::system::error_code ec;
+      boost::filesystem::create_directories(outPath.parent_path(), ec);
+    }
+    openstudio::path inputPath = inputPaths[i];
+    pool.post([&results,&options,i,inputPath,outPath,profiling]() {
+      // With profiling off the conversions only ever test a null pointer
+      std::shared_ptr<Profile> profile;
+      if(profiling) {
+        profile = std::make_shared<Profile>();
+      }
+      // Every slot has to be filled, drain would wait for it forever otherwise
+      ConversionResult result = {false, false, std::string()};
+      try {
+        if(options.incremental) {
+          result = convertIncremental(inputPath, outPath, options, profile.get());
+        } else {
+          result = convert(inputPath, outPath, options, profile.get());
+        }
+      } catch(std::exception &e) {
+        result.message = std::string("Conversion failed: ") + e.what();
+      } catch(...) {
+        result.message = "Conversion failed with an unknown exception";
+      }
+      result.profile = profile;
+      results.set(i, result);
+    });
+  }
+
+  unsigned failures = 0;
+  unsigned skipped = 0;
+  results.drain([&](std::size_t i, const ConversionResult &result) {
+    if(!result.success) {
+      ++failures;
+    }
+    if(result.skipped) {
+      ++skipped;
+    }
+    if(single) {
+      if(!result.success) {
+        report << result.message << std::endl;
+      }
+    } else if(!result.success || !quiet) {
+      report << (result.skipped ? "SKIPPED " : (result.success ? "OK " : "FAILED ")) << openstudio::toString(inputPaths[i])
+        << ": " << result.message << std::endl;
+    }
+    if(result.profile) {
+      if(profileJson) {
+        *profileStream << (i ? "," : "") << "\n{\"input\":\"" << jsonEscape(openstudio::toString(inputPaths[i]))
+          << "\",\"success\":" << (result.success ? "true" : "false") << ",\"skipped\":" << (result.skipped ? "true" : "false")
+          << ",\"profile\":";
+        result.profile->writeJson(*profileStream);
+        *profileStream << "}";
+      } else {
+        *profileStream << "Profile of " << openstudio::toString(inputPaths[i]) << ":" << std::endl;
+        result.profile->writeText(*profileStream);
+      }
+    }
+  });
 
+  if(profiling) {
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    if(profileJson) {
+      *profileStream << "\n],\"jobs\":" << jobs << ",\"wall_seconds\":" << wall << ",\"peak_rss_bytes\":"
+        << peakResidentBytes() << "}" << std::endl;
+    } else {
+      *profileStream << "Total wall time " << 1000.0*wall << " ms on " << jobs << " job" << (jobs == 1 ? "" : "s")
+        << ", peak RSS " << peakResidentBytes()/1048576.0 << " MB" << std::endl;
+    }
+  }
+
+  if(!single && !quiet) {
+    report << inputPaths.size()-failures-skipped << " of " << inputPaths.size() << " files converted";
+    if(options.incremental) {
+      report << ", " << skipped << " up to date";
+    }
+    report << std::endl;
+  }
+
+  if(failures) {
+    return EXIT_FAILURE;
+  }
   return EXIT_SUCCESS;
 }